@@ -0,0 +1,215 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "assignmentbound.h"
+
+AssignmentBound::AssignmentBound(const LevelData* level)
+    : m_usable(false), m_cellCount(level->cellCount()), m_anchorCount(level->goalAnchorCount()), m_kindCount(0)
+{
+    if (m_cellCount > MaxCells)
+        return;
+
+    // atom kinds present in the level, in order of appearance
+    QVector<int> kindNums;
+    const QList<LevelData::Element> atoms = level->atomElements();
+    foreach (const LevelData::Element& el, atoms)
+    {
+        int kind = kindNums.indexOf(el.atom);
+        if (kind == -1)
+        {
+            kind = kindNums.count();
+            kindNums.append(el.atom);
+            m_kindAtoms.append(QVector<int>());
+        }
+        m_kindAtoms[kind].append(m_atomKinds.count());
+        m_atomKinds.append(kind);
+        if (m_kindAtoms.at(kind).count() > MaxKindSize)
+            return;
+    }
+    m_kindCount = kindNums.count();
+
+    // places of each kind in the molecule. if they don't match the atoms,
+    // no anchor can ever be completed
+    m_places.resize(m_kindCount);
+    QVector<int> placeCounts(m_kindCount, 0);
+    foreach (const LevelData::Element& el, level->moleculeAtoms())
+    {
+        const int kind = kindNums.indexOf(el.atom);
+        if (kind == -1)
+        {
+            m_anchorCount = 0;
+            break;
+        }
+        placeCounts[kind]++;
+    }
+    for (int kind = 0; kind < m_kindCount; ++kind)
+        if (placeCounts.at(kind) != m_kindAtoms.at(kind).count())
+            m_anchorCount = 0;
+
+    const int stride = level->stride();
+    for (int k = 0; k < m_anchorCount; ++k)
+        foreach (const LevelData::Element& el, level->moleculeAtoms())
+            m_places[kindNums.indexOf(el.atom)].append(level->goalAnchorCell(k) + el.y*stride + el.x);
+
+    // distances from every cell, breadth-first over straight runs
+    m_distances.fill(0xff, m_cellCount * m_cellCount);
+    QVector<int> queue;
+    for (int from = 0; from < m_cellCount; ++from)
+    {
+        if (level->containsWallAt(from % stride, from / stride))
+            continue;
+        quint8* dist = m_distances.data() + from*m_cellCount;
+        dist[from] = 0;
+        queue.clear();
+        queue.append(from);
+        for (int head = 0; head < queue.count(); ++head)
+        {
+            const int cell = queue.at(head);
+            // very long ways are cut, which keeps the bound admissible
+            const int next = qMin(dist[cell] + 1, 0xfe);
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int len = level->wallDistance(cell, static_cast<KAtomic::Direction>(dir));
+                const int step = level->step(static_cast<KAtomic::Direction>(dir));
+                for (int i = 1; i <= len; ++i)
+                {
+                    const int to = cell + i*step;
+                    if (dist[to] == 0xff)
+                    {
+                        dist[to] = next;
+                        queue.append(to);
+                    }
+                }
+            }
+        }
+    }
+
+    m_costs.fill(0, m_anchorCount * m_kindCount);
+    m_sums.fill(0, m_anchorCount);
+    m_usable = true;
+}
+
+int AssignmentBound::value() const
+{
+    int best = Unreachable;
+    for (int k = 0; k < m_anchorCount; ++k)
+        best = qMin(best, m_sums.at(k));
+    return best < Unreachable ? best : int(Infinite);
+}
+
+void AssignmentBound::undoMove()
+{
+    const int top = m_undoStack.count() - m_anchorCount - 1;
+    const int kind = m_undoStack.at(top);
+    for (int k = 0; k < m_anchorCount; ++k)
+        setCost(k, kind, m_undoStack.at(top + 1 + k));
+    m_undoStack.resize(top);
+}
+
+int AssignmentBound::assign(int kind, int anchor, const int* atomCells) const
+{
+    const int n = m_kindAtoms.at(kind).count();
+    const int* places = m_places.at(kind).constData() + anchor*n;
+    if (n == 1)
+    {
+        const int d = distance(atomCells[0], places[0]);
+        return d == 0xff ? int(Unreachable) : d;
+    }
+
+    int cost[MaxKindSize][MaxKindSize];
+    for (int i = 0; i < n; ++i)
+        for (int j = 0; j < n; ++j)
+        {
+            const int d = distance(atomCells[i], places[j]);
+            cost[i][j] = d == 0xff ? Unreachable : d;
+        }
+
+    int result;
+    if (n == 2)
+    {
+        result = qMin(cost[0][0] + cost[1][1], cost[0][1] + cost[1][0]);
+    }
+    else
+    {
+        // Hungarian algorithm with potentials, O(n^3). rows are atoms,
+        // columns places, index 0 is a virtual column
+        int u[MaxKindSize + 1], v[MaxKindSize + 1], match[MaxKindSize + 1], way[MaxKindSize + 1];
+        for (int j = 0; j <= n; ++j)
+            u[j] = v[j] = match[j] = way[j] = 0;
+        for (int i = 1; i <= n; ++i)
+        {
+            int minv[MaxKindSize + 1];
+            bool used[MaxKindSize + 1];
+            for (int j = 0; j <= n; ++j)
+            {
+                minv[j] = Infinite;
+                used[j] = false;
+            }
+            match[0] = i;
+            int j0 = 0;
+            do
+            {
+                used[j0] = true;
+                const int i0 = match[j0];
+                int delta = Infinite;
+                int j1 = 0;
+                for (int j = 1; j <= n; ++j)
+                {
+                    if (used[j])
+                        continue;
+                    const int cur = cost[i0 - 1][j - 1] - u[i0] - v[j];
+                    if (cur < minv[j])
+                    {
+                        minv[j] = cur;
+                        way[j] = j0;
+                    }
+                    if (minv[j] < delta)
+                    {
+                        delta = minv[j];
+                        j1 = j;
+                    }
+                }
+                for (int j = 0; j <= n; ++j)
+                {
+                    if (used[j])
+                    {
+                        u[match[j]] += delta;
+                        v[j] -= delta;
+                    }
+                    else
+                    {
+                        minv[j] -= delta;
+                    }
+                }
+                j0 = j1;
+            } while (match[j0] != 0);
+            do
+            {
+                const int j1 = way[j0];
+                match[j0] = match[j1];
+                j0 = j1;
+            } while (j0);
+        }
+        result = -v[0];
+    }
+
+    return qMin(result, int(Unreachable));
+}
@@ -0,0 +1,134 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_ASSIGNMENTBOUND_H
+#define KATOMIC_ASSIGNMENTBOUND_H
+
+#include <QVector>
+
+#include "levelset.h"
+
+/**
+ * Lower bound of the moves left to solve a position, for search.
+ *
+ * For every feasible goal anchor, atoms of each kind are matched to that
+ * kind's places in the molecule with a minimum cost assignment, costs being
+ * the straight-run distances between cells (see LevelData::goalDistance()).
+ * The bound is the cheapest anchor. Unlike summing each atom's distance to
+ * the nearest matching place, several identical atoms (hydrogens, mostly)
+ * can't all count the same place.
+ *
+ * Costs are kept per anchor and atom kind, so after a move only the moved
+ * atom's kind is reassigned, and undoing it restores the saved costs. Cell
+ * to cell distances are a table that is only built for fields of at most
+ * MaxCells cells; isUsable() tells if the level qualifies.
+ */
+class AssignmentBound
+{
+public:
+    enum { MaxCells = 32*32, Infinite = 0x3fffffff };
+
+    explicit AssignmentBound(const LevelData* level);
+
+    bool isUsable() const { return m_usable; }
+
+    /**
+     *  Computes all costs for the atoms at cells (cells[i] is the cell of atom i)
+     */
+    template<typename Cell>
+    void reset(const Cell* cells)
+    {
+        m_costs.fill(0);
+        m_sums.fill(0);
+        m_undoStack.clear();
+        for (int kind = 0; kind < m_kindCount; ++kind)
+            updateKind(kind, cells);
+    }
+    /**
+     *  Updates the costs after atom idx has moved
+     */
+    template<typename Cell>
+    void atomMoved(int idx, const Cell* cells)
+    {
+        const int kind = m_atomKinds.at(idx);
+        m_undoStack.append(kind);
+        for (int k = 0; k < m_anchorCount; ++k)
+            m_undoStack.append(m_costs.at(k*m_kindCount + kind));
+        updateKind(kind, cells);
+    }
+    /**
+     *  Reverts the costs to before the last atomMoved() not undone yet
+     */
+    void undoMove();
+
+    /**
+     *  The bound, Infinite if the molecule can't be built anymore
+     */
+    int value() const;
+
+private:
+    int distance(int from, int to) const { return m_distances.at(from*m_cellCount + to); }
+
+    template<typename Cell>
+    void updateKind(int kind, const Cell* cells)
+    {
+        const QVector<int>& atoms = m_kindAtoms.at(kind);
+        int atomCells[MaxKindSize];
+        for (int i = 0; i < atoms.count(); ++i)
+            atomCells[i] = cells[atoms.at(i)];
+        for (int k = 0; k < m_anchorCount; ++k)
+            setCost(k, kind, assign(kind, k, atomCells));
+    }
+
+    void setCost(int anchor, int kind, int cost)
+    {
+        int& old = m_costs[anchor*m_kindCount + kind];
+        m_sums[anchor] += cost - old;
+        old = cost;
+    }
+
+    /**
+     *  Minimum cost of assigning atoms at atomCells to the places of kind at anchor
+     */
+    int assign(int kind, int anchor, const int* atomCells) const;
+
+    // cost of assignments using unreachable places. sums of up to 255 of them still fit an int
+    enum { MaxKindSize = 64, Unreachable = 0x100000 };
+
+    bool m_usable;
+    int m_cellCount;
+    int m_anchorCount;
+    int m_kindCount;
+    // straight-run distance between any two cells, at from*m_cellCount + to
+    QVector<quint8> m_distances;
+    // atoms of the level by kind, kind of each atom
+    QVector<QVector<int> > m_kindAtoms;
+    QVector<int> m_atomKinds;
+    // for every kind, place cells per anchor, m_kindAtoms[kind].count() of them each
+    QVector<QVector<int> > m_places;
+    // assignment cost of each kind at each anchor, at anchor*m_kindCount + kind,
+    // and their sum per anchor
+    QVector<int> m_costs;
+    QVector<int> m_sums;
+    // for every atomMoved(): moved kind, then its old costs at the anchors
+    QVector<int> m_undoStack;
+};
+
+#endif
@@ -0,0 +1,192 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_ATOMCLASSES_H
+#define KATOMIC_ATOMCLASSES_H
+
+#include <QBitArray>
+#include <QVector>
+
+#include <string.h>
+
+#include "solver.h"
+
+/**
+ * Groups of interchangeable atoms: atoms with the same atom number (see
+ * PlayField::saveGame()) can swap places without changing the position.
+ *
+ * Searches that store positions as one cell per atom keep them in canonical
+ * form, with the cells of each group in ascending order, so all orders of
+ * identical atoms are the same state. Atom indices in such states don't
+ * follow the atoms, so paths through them name the moving atom by its cell
+ * (see movedFromCell() and resolveAtoms()).
+ */
+class AtomClasses
+{
+public:
+    template<class Board>
+    explicit AtomClasses(const Board& board)
+    {
+        QBitArray grouped(board.atomCount());
+        for (int i = 0; i < board.atomCount(); ++i)
+        {
+            if (grouped.testBit(i))
+                continue;
+            QVector<int> members;
+            for (int j = i; j < board.atomCount(); ++j)
+            {
+                if (board.atomNum(j) == board.atomNum(i))
+                {
+                    members.append(j);
+                    grouped.setBit(j);
+                }
+            }
+            // single atoms are always in order
+            if (members.count() > 1)
+            {
+                m_starts.append(m_members.count());
+                m_members += members;
+            }
+        }
+        m_starts.append(m_members.count());
+    }
+
+    /**
+     *  Whether some atoms are interchangeable
+     */
+    bool isEmpty() const { return m_members.isEmpty(); }
+
+    /**
+     *  Sorts cells within each group
+     */
+    template<typename Cell>
+    void canonicalize(Cell* cells) const
+    {
+        for (int g = 0; g + 1 < m_starts.count(); ++g)
+        {
+            const int* members = m_members.constData() + m_starts.at(g);
+            const int count = m_starts.at(g + 1) - m_starts.at(g);
+            // groups are small and at most one atom is out of place
+            // after a move, so insertion sort does
+            for (int i = 1; i < count; ++i)
+            {
+                const Cell cell = cells[members[i]];
+                int j = i;
+                for (; j > 0 && cells[members[j - 1]] > cell; --j)
+                    cells[members[j]] = cells[members[j - 1]];
+                cells[members[j]] = cell;
+            }
+        }
+    }
+
+    /**
+     *  Canonical form of cells, either cells itself or a copy in buffer
+     */
+    template<typename Cell>
+    const Cell* canonical(const Cell* cells, Cell* buffer, int atomCount) const
+    {
+        if (isEmpty())
+            return cells;
+        memcpy(buffer, cells, atomCount * sizeof(Cell));
+        canonicalize(buffer);
+        return buffer;
+    }
+
+    /**
+     *  Cell the moving atom left on a move from position before to position
+     *  after, whatever order either lists the atoms in
+     */
+    template<typename Cell>
+    static int movedFromCell(const Cell* before, const Cell* after, int atomCount)
+    {
+        for (int i = 0; i < atomCount; ++i)
+        {
+            bool left = true;
+            for (int j = 0; j < atomCount && left; ++j)
+                left = after[j] != before[i];
+            if (left)
+                return before[i];
+        }
+        return -1;
+    }
+
+    /**
+     *  Fills in the atoms of moves by replaying them on board, which starts
+     *  at the level's start: move i is made by the atom in fromCells[i]
+     */
+    template<class Board>
+    static void resolveAtoms(Board* board, QVector<SolverMove>* moves, const QVector<int>& fromCells)
+    {
+        for (int i = 0; i < moves->count(); ++i)
+        {
+            SolverMove& mv = (*moves)[i];
+            for (int atom = 0; atom < board->atomCount(); ++atom)
+            {
+                if (board->atomCell(atom) == fromCells.at(i))
+                {
+                    mv.atom = atom;
+                    break;
+                }
+            }
+            board->moveAtom(mv.atom, mv.dir, board->slideDistance(mv.atom, mv.dir));
+        }
+    }
+
+    /**
+     *  Move stored by search tables as atom << 2 | dir, with the atom's index
+     *  in the canonical state it was made from and numCells left 0
+     */
+    static SolverMove tableMove(quint16 move)
+    {
+        SolverMove mv;
+        mv.atom = move >> 2;
+        mv.dir = static_cast<KAtomic::Direction>(move & 3);
+        mv.numCells = 0;
+        return mv;
+    }
+
+    /**
+     *  Moves from the start to state of table, a StateTable or
+     *  ConcurrentStateTable of canonical states, found by following the
+     *  parents back. The atoms are resolved for the level's start position
+     */
+    template<class Board, class Table>
+    static QVector<SolverMove> tablePath(const LevelData* level, const Table& table, quint32 state, int atomCount)
+    {
+        QVector<SolverMove> moves;
+        QVector<int> fromCells;
+        for (quint32 s = state; table.parent(s) != Table::NoParent; s = table.parent(s))
+        {
+            moves.prepend(tableMove(table.move(s)));
+            fromCells.prepend(movedFromCell(table.state(table.parent(s)), table.state(s), atomCount));
+        }
+        Board start(level);
+        resolveAtoms(&start, &moves, fromCells);
+        return moves;
+    }
+
+private:
+    // indices of the atoms of group g are m_members[m_starts[g]] up to
+    // m_members[m_starts[g + 1]], groups of one atom are left out
+    QVector<int> m_members;
+    QVector<int> m_starts;
+};
+
+#endif
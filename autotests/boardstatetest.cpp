@@ -0,0 +1,191 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTest>
+
+#include "boardstate.h"
+#include "levelset.h"
+
+using namespace KAtomic;
+
+// the atoms of a board, as cell numbers
+static QVector<int> atomCells(const BoardState& board)
+{
+    QVector<int> cells(board.atomCount());
+    for (int idx = 0; idx < board.atomCount(); ++idx)
+        cells[idx] = board.atomCell(idx);
+    return cells;
+}
+
+class BoardStateTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void slideStopsAtWalls();
+    void slideStopsAtAtoms();
+    void undoRestoresPosition();
+    void solvedAtGoal();
+    void fixedAndSparseAgree();
+
+private:
+    LevelSet m_levelSet;
+};
+
+void BoardStateTest::initTestCase()
+{
+    QVERIFY(m_levelSet.loadFromFile(QFINDTESTDATA("data/testlevels.dat")));
+    QCOMPARE(m_levelSet.levelCount(), 2);
+}
+
+void BoardStateTest::slideStopsAtWalls()
+{
+    // atom 0 at (1,1) with a wall at (4,1), atom 1 at (2,3), nothing else
+    QScopedPointer<BoardState> board(BoardState::create(m_levelSet.levelData(1)));
+    QCOMPARE(board->atomCount(), 2);
+    QCOMPARE(board->slideDistance(0, Up), 1);
+    QCOMPARE(board->slideDistance(0, Down), 3);
+    QCOMPARE(board->slideDistance(0, Left), 1);
+    QCOMPARE(board->slideDistance(0, Right), 2);
+    QCOMPARE(board->slideDistance(1, Up), 3);
+    QCOMPARE(board->slideDistance(1, Right), 3);
+
+    QCOMPARE(board->applyMove(0, Right), 2);
+    QCOMPARE(board->atomX(0), 3);
+    QCOMPARE(board->atomY(0), 1);
+    QVERIFY(!board->canMove(0, Right));
+    QCOMPARE(board->applyMove(0, Right), 0);
+    QCOMPARE(board->atomX(0), 3);
+}
+
+void BoardStateTest::slideStopsAtAtoms()
+{
+    QScopedPointer<BoardState> board(BoardState::create(m_levelSet.levelData(1)));
+    QCOMPARE(board->applyMove(0, Down), 3);
+    QCOMPARE(board->applyMove(1, Down), 1);
+    // side by side on the bottom row, each blocks the other
+    QCOMPARE(board->slideDistance(0, Right), 0);
+    QCOMPARE(board->slideDistance(1, Left), 0);
+    QCOMPARE(board->slideDistance(1, Up), 4);
+    QVERIFY(!board->cellIsEmpty(1, 4));
+    QVERIFY(board->cellIsEmpty(1, 1));
+
+    // around the field, then atom 0 stops next to atom 1 instead of at the edge
+    QCOMPARE(board->applyMove(1, Up), 4);
+    QCOMPARE(board->applyMove(0, Right), 4);
+    QCOMPARE(board->applyMove(0, Up), 4);
+    QCOMPARE(board->applyMove(1, Left), 2);
+    QCOMPARE(board->applyMove(0, Left), 4);
+    QCOMPARE(board->atomX(0), 1);
+    QCOMPARE(board->atomY(0), 0);
+}
+
+void BoardStateTest::undoRestoresPosition()
+{
+    QScopedPointer<BoardState> board(BoardState::create(m_levelSet.levelData(2)));
+    const QVector<int> startCells = atomCells(*board);
+    const quint64 startHash = board->hash();
+
+    MoveList moves;
+    QVERIFY(board->generateMoves(&moves) > 0);
+    for (int m = 0; m < moves.count; ++m)
+    {
+        const int atom = moves.atoms[m];
+        const Direction dir = static_cast<Direction>(moves.dirs[m]);
+        QCOMPARE(board->applyMove(atom, dir), int(moves.distances[m]));
+        QVERIFY(board->hash() != startHash);
+        board->undoMove(atom, dir, moves.distances[m]);
+        QCOMPARE(board->hash(), startHash);
+        QCOMPARE(atomCells(*board), startCells);
+    }
+
+    // moveAtom() by the same distance is an undo too
+    const int dist = board->applyMove(0, Down);
+    board->moveAtom(0, BoardState::opposite(Down), dist);
+    QCOMPARE(board->hash(), startHash);
+    QCOMPARE(atomCells(*board), startCells);
+}
+
+void BoardStateTest::solvedAtGoal()
+{
+    QScopedPointer<BoardState> board(BoardState::create(m_levelSet.levelData(1)));
+    QVERIFY(!board->isSolved());
+    board->applyMove(0, Down);
+    QVERIFY(!board->isSolved());
+    // atom 1 right of atom 0 on the bottom row makes the molecule
+    board->applyMove(1, Down);
+    QVERIFY(board->isSolved());
+    board->undoMove(1, Down, 1);
+    QVERIFY(!board->isSolved());
+
+    // the same goal reached through setAtomCells()
+    const int stride = m_levelSet.levelData(1)->stride();
+    const int cells[] = { 2*stride + 4, 2*stride + 5 };
+    board->setAtomCells(cells);
+    QVERIFY(board->isSolved());
+}
+
+void BoardStateTest::fixedAndSparseAgree()
+{
+    const LevelData* level = m_levelSet.levelData(2);
+    QScopedPointer<BoardState> fixed(BoardState::create(level));
+    SparseBoardState sparse(level);
+    QVERIFY(!dynamic_cast<SparseBoardState*>(fixed.data()));
+
+    // a fixed walk through the level, comparing everything on the way
+    MoveList fixedMoves;
+    MoveList sparseMoves;
+    for (int step = 0; step < 200; ++step)
+    {
+        QCOMPARE(atomCells(sparse), atomCells(*fixed));
+        QCOMPARE(sparse.hash(), fixed->hash());
+        QCOMPARE(sparse.isSolved(), fixed->isSolved());
+        for (int idx = 0; idx < fixed->atomCount(); ++idx)
+            for (int dir = Up; dir <= Right; ++dir)
+                QCOMPARE(sparse.slideDistance(idx, static_cast<Direction>(dir)), fixed->slideDistance(idx, static_cast<Direction>(dir)));
+
+        QCOMPARE(sparse.generateReverseMoves(&sparseMoves), fixed->generateReverseMoves(&fixedMoves));
+        for (int m = 0; m < fixedMoves.count; ++m)
+        {
+            QCOMPARE(sparseMoves.atoms[m], fixedMoves.atoms[m]);
+            QCOMPARE(sparseMoves.dirs[m], fixedMoves.dirs[m]);
+            QCOMPARE(sparseMoves.distances[m], fixedMoves.distances[m]);
+        }
+        QCOMPARE(sparse.generateMoves(&sparseMoves), fixed->generateMoves(&fixedMoves));
+        for (int m = 0; m < fixedMoves.count; ++m)
+        {
+            QCOMPARE(sparseMoves.atoms[m], fixedMoves.atoms[m]);
+            QCOMPARE(sparseMoves.dirs[m], fixedMoves.dirs[m]);
+            QCOMPARE(sparseMoves.distances[m], fixedMoves.distances[m]);
+        }
+
+        const int m = (step * 7) % fixedMoves.count;
+        const Direction dir = static_cast<Direction>(fixedMoves.dirs[m]);
+        QCOMPARE(sparse.applyMove(fixedMoves.atoms[m], dir), fixed->applyMove(fixedMoves.atoms[m], dir));
+    }
+}
+
+QTEST_GUILESS_MAIN(BoardStateTest)
+
+#include "boardstatetest.moc"
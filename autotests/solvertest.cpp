@@ -0,0 +1,333 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include <QObject>
+#include <QScopedPointer>
+#include <QTemporaryDir>
+#include <QTest>
+
+#include "boardstate.h"
+#include "levelset.h"
+#include "solutionoptimizer.h"
+#include "solver.h"
+#include "stateranking.h"
+#include "tablebase.h"
+
+// levels every mode solves in well under a second, with their shortest
+// solution lengths as found by bfs
+static const struct
+{
+    const char* name;
+    bool shipped;
+    int levelNum;
+    int length;
+} knownLevels[] = {
+    { "default_levels 1", true, 1, 15 },
+    { "testlevels 1", false, 1, 2 },
+    { "testlevels 2", false, 2, 13 }
+};
+
+// collects the solutions an anytime mode reports
+class ProgressRecorder : public SolverProgress
+{
+public:
+    void improved(const QVector<SolverMove>& moves, qint64) Q_DECL_OVERRIDE { solutions << moves; }
+
+    QVector<QVector<SolverMove> > solutions;
+};
+
+class SolverTest : public QObject
+{
+    Q_OBJECT
+
+private Q_SLOTS:
+    void initTestCase();
+    void optimal_data();
+    void optimal();
+    void stateRanking_data();
+    void stateRanking();
+    void tablebase_data();
+    void tablebase();
+    void beam_data();
+    void beam();
+    void shorten_data();
+    void shorten();
+
+private:
+    void addLevelRows(const QStringList& modes);
+    const LevelData* level(bool shipped, int levelNum) const;
+    SolverOptions options() const;
+    void verifySolution(const LevelData* level, const QVector<SolverMove>& moves);
+
+    LevelSet m_shippedLevels;
+    LevelSet m_testLevels;
+};
+
+void SolverTest::initTestCase()
+{
+    QVERIFY(m_shippedLevels.loadFromFile(QFINDTESTDATA("../levels/default_levels.dat")));
+    QVERIFY(m_testLevels.loadFromFile(QFINDTESTDATA("data/testlevels.dat")));
+}
+
+const LevelData* SolverTest::level(bool shipped, int levelNum) const
+{
+    return (shipped ? m_shippedLevels : m_testLevels).levelData(levelNum);
+}
+
+SolverOptions SolverTest::options() const
+{
+    SolverOptions options;
+    options.memoryLimit = Q_UINT64_C(512) << 20;
+    options.transpositionTableSize = Q_UINT64_C(16) << 20;
+    options.threadCount = 2;
+    return options;
+}
+
+// replays moves on a fresh board of level
+void SolverTest::verifySolution(const LevelData* level, const QVector<SolverMove>& moves)
+{
+    QScopedPointer<BoardState> board(BoardState::create(level));
+    foreach (const SolverMove& mv, moves)
+    {
+        QVERIFY(!board->isSolved());
+        QVERIFY(mv.numCells > 0);
+        QCOMPARE(board->applyMove(mv.atom, mv.dir), mv.numCells);
+    }
+    QVERIFY(board->isSolved());
+}
+
+// rows of knownLevels for each of modes, an empty mode for tests without one
+void SolverTest::addLevelRows(const QStringList& modes)
+{
+    QTest::addColumn<QString>("mode");
+    QTest::addColumn<bool>("shipped");
+    QTest::addColumn<int>("levelNum");
+    QTest::addColumn<int>("length");
+
+    foreach (const QString& mode, modes)
+    {
+        for (size_t i = 0; i < sizeof(knownLevels) / sizeof(knownLevels[0]); ++i)
+        {
+            const QString name = QLatin1String(knownLevels[i].name);
+            QTest::newRow(qPrintable(mode.isEmpty() ? name : QString(mode + QLatin1Char(' ') + name)))
+                << mode << knownLevels[i].shipped << knownLevels[i].levelNum << knownLevels[i].length;
+        }
+    }
+}
+
+void SolverTest::optimal_data()
+{
+    const QStringList modes = QStringList() << QStringLiteral("bfs") << QStringLiteral("ida") << QStringLiteral("pbfs")
+        << QStringLiteral("pida") << QStringLiteral("bidir") << QStringLiteral("ebfs")
+        << QStringLiteral("rbfs");
+    addLevelRows(modes);
+}
+
+void SolverTest::optimal()
+{
+    QFETCH(QString, mode);
+    QFETCH(bool, shipped);
+    QFETCH(int, levelNum);
+    QFETCH(int, length);
+
+    QScopedPointer<Solver> solver(Solver::create(mode, options()));
+    QVERIFY(solver);
+    QVERIFY(solver->isOptimal());
+    const LevelData* levelData = level(shipped, levelNum);
+    QVERIFY(levelData);
+    const SolverResult result = solver->solve(levelData);
+    QCOMPARE(result.status, SolverResult::Solved);
+    verifySolution(levelData, result.moves);
+    QCOMPARE(result.moves.count(), length);
+}
+
+void SolverTest::stateRanking_data()
+{
+    addLevelRows(QStringList() << QString());
+}
+
+void SolverTest::stateRanking()
+{
+    QFETCH(bool, shipped);
+    QFETCH(int, levelNum);
+
+    const LevelData* levelData = level(shipped, levelNum);
+    const StateRanking ranking(levelData);
+    QVERIFY(ranking.stateCount() > 0);
+    QScopedPointer<BoardState> board(BoardState::create(levelData));
+    const quint64 startHash = board->hash();
+    QVector<int> cells(board->atomCount());
+
+    // every rank of small levels, evenly spread ones of larger levels
+    const quint64 step = qMax(quint64(1), ranking.stateCount() / 10000);
+    for (quint64 idx = 0; idx < ranking.stateCount(); idx += step)
+    {
+        ranking.unrank(idx, cells.data());
+        for (int atom = 0; atom < cells.count(); ++atom)
+            QVERIFY(!levelData->isDeadCell(board->atomNum(atom), cells.at(atom)));
+        QCOMPARE(ranking.rank(cells.constData()), idx);
+    }
+
+    // the start position comes back, up to the order of identical atoms
+    for (int atom = 0; atom < cells.count(); ++atom)
+        cells[atom] = board->atomCell(atom);
+    const quint64 startRank = ranking.rank(cells.constData());
+    QVERIFY(startRank < ranking.stateCount());
+    ranking.unrank(startRank, cells.data());
+    board->setAtomCells(cells.constData());
+    QCOMPARE(board->hash(), startHash);
+}
+
+void SolverTest::tablebase_data()
+{
+    addLevelRows(QStringList() << QString());
+}
+
+void SolverTest::tablebase()
+{
+    QFETCH(bool, shipped);
+    QFETCH(int, levelNum);
+    QFETCH(int, length);
+
+    const LevelData* levelData = level(shipped, levelNum);
+    QTemporaryDir tempDir;
+    QVERIFY(tempDir.isValid());
+    const QString fileName = tempDir.path() + QStringLiteral("/level.tablebase");
+    QVERIFY(Tablebase::build(levelData, fileName, Q_UINT64_C(64) << 20) > 0);
+    QScopedPointer<Tablebase> table(Tablebase::open(levelData, fileName));
+    QVERIFY(table);
+
+    // the start is as far from the molecule as the bfs solution is long,
+    // and following the hints gets there in that many moves
+    QScopedPointer<BoardState> board(BoardState::create(levelData));
+    QCOMPARE(table->distance(board.data()), length);
+    int atom;
+    KAtomic::Direction dir;
+    for (int left = length; left > 0; --left)
+    {
+        QVERIFY(table->bestMove(board.data(), &atom, &dir));
+        QVERIFY(board->applyMove(atom, dir) > 0);
+        QCOMPARE(table->distance(board.data()), left - 1);
+    }
+    QVERIFY(board->isSolved());
+    QVERIFY(!table->bestMove(board.data(), &atom, &dir));
+
+    // a position one move before another is at most one move further from
+    // the molecule, and can't be unsolvable if the other isn't
+    QScopedPointer<BoardState> walk(BoardState::create(levelData));
+    MoveList moves;
+    for (int step = 0; step < 200 && walk->generateMoves(&moves) > 0; ++step)
+    {
+        const int before = table->distance(walk.data());
+        const int m = (step * 7) % moves.count;
+        walk->applyMove(moves.atoms[m], static_cast<KAtomic::Direction>(moves.dirs[m]));
+        const int after = table->distance(walk.data());
+        if (after >= 0)
+            QVERIFY(before >= 0 && before <= after + 1);
+    }
+}
+
+void SolverTest::beam_data()
+{
+    addLevelRows(QStringList() << QStringLiteral("beam"));
+}
+
+void SolverTest::beam()
+{
+    QFETCH(QString, mode);
+    QFETCH(bool, shipped);
+    QFETCH(int, levelNum);
+    QFETCH(int, length);
+
+    // starting from one position per depth, so that the first solutions
+    // are rarely the shortest ones
+    SolverOptions beamOptions = options();
+    beamOptions.beamWidth = 1;
+    beamOptions.timeLimit = 10;
+    ProgressRecorder progress;
+    beamOptions.progress = &progress;
+    QScopedPointer<Solver> solver(Solver::create(mode, beamOptions));
+    QVERIFY(solver);
+    QVERIFY(!solver->isOptimal());
+    const LevelData* levelData = level(shipped, levelNum);
+    const SolverResult result = solver->solve(levelData);
+    QCOMPARE(result.status, SolverResult::Solved);
+    verifySolution(levelData, result.moves);
+    QVERIFY(result.moves.count() >= length);
+
+    // every solution reported on the way is valid and shorter than the one before
+    QVERIFY(!progress.solutions.isEmpty());
+    for (int i = 0; i < progress.solutions.count(); ++i)
+    {
+        verifySolution(levelData, progress.solutions.at(i));
+        QVERIFY(progress.solutions.at(i).count() >= length);
+        if (i > 0)
+            QVERIFY(progress.solutions.at(i).count() < progress.solutions.at(i - 1).count());
+    }
+    QCOMPARE(progress.solutions.last().count(), result.moves.count());
+}
+
+void SolverTest::shorten_data()
+{
+    addLevelRows(QStringList() << QString());
+}
+
+void SolverTest::shorten()
+{
+    QFETCH(bool, shipped);
+    QFETCH(int, levelNum);
+    QFETCH(int, length);
+
+    // the first solution of a beam search one position wide as the long one
+    SolverOptions beamOptions = options();
+    beamOptions.beamWidth = 1;
+    beamOptions.timeLimit = 10;
+    ProgressRecorder progress;
+    beamOptions.progress = &progress;
+    QScopedPointer<Solver> solver(Solver::create(QStringLiteral("beam"), beamOptions));
+    const LevelData* levelData = level(shipped, levelNum);
+    solver->solve(levelData);
+    QVERIFY(!progress.solutions.isEmpty());
+
+    const SolutionOptimizer optimizer;
+    QVector<SolverMove> moves = progress.solutions.first();
+    const int before = moves.count();
+    QVERIFY(optimizer.optimize(levelData, &moves));
+    verifySolution(levelData, moves);
+    QVERIFY(moves.count() <= before);
+    QVERIFY(moves.count() >= length);
+
+    // a shortest solution stays as long as it is
+    QScopedPointer<Solver> bfs(Solver::create(QStringLiteral("bfs"), options()));
+    moves = bfs->solve(levelData).moves;
+    QVERIFY(optimizer.optimize(levelData, &moves));
+    verifySolution(levelData, moves);
+    QCOMPARE(moves.count(), length);
+
+    // moves that stop short of the molecule are no solution and stay alone
+    moves.removeLast();
+    QVERIFY(!optimizer.optimize(levelData, &moves));
+    QCOMPARE(moves.count(), length - 1);
+}
+
+QTEST_GUILESS_MAIN(SolverTest)
+
+#include "solvertest.moc"
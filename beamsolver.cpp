@@ -0,0 +1,309 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "beamsolver.h"
+
+#include <QElapsedTimer>
+#include <QMultiHash>
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#include "atomclasses.h"
+
+namespace
+{
+
+template<class Board>
+class BeamSearch
+{
+public:
+    typedef typename Board::Cell Cell;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        BeamSearch search(level, options);
+        return search.solve();
+    }
+
+private:
+    enum { NoParent = 0xffffffff };
+
+    typedef QMultiHash<quint64, quint32> Seen;
+
+    /**
+     * Kept position, with the move that led to it from position parent of
+     * the depth before
+     */
+    struct Node
+    {
+        quint32 parent;
+        quint16 atom;
+        quint8 dir;
+        quint8 numCells;
+    };
+
+    /**
+     * Successor that may be kept for the next depth
+     */
+    struct Candidate
+    {
+        quint32 estimate;
+        quint32 parent;
+        quint64 hash;
+        int cell;
+        quint16 atom;
+        quint8 dir;
+        quint8 numCells;
+
+        bool operator<(const Candidate& other) const
+        {
+            // by hash on ties, so that copies of a position end up together
+            return estimate != other.estimate ? estimate < other.estimate : hash < other.hash;
+        }
+    };
+
+    BeamSearch(const LevelData* level, const SolverOptions& options)
+        : m_level(level), m_options(options), m_board(level), m_atomCount(m_board.atomCount()),
+        m_classes(m_board), m_startCells(m_atomCount), m_key(m_atomCount), m_other(m_atomCount),
+        m_timeLimit(options.timeLimit > 0 ? options.timeLimit : int(BeamSolver::DefaultTimeLimit)), m_stored(0), m_expanded(0), m_aborted(false)
+    {
+        for (int i = 0; i < m_atomCount; ++i)
+            m_startCells[i] = m_board.atomCell(i);
+    }
+
+    SolverResult solve()
+    {
+        m_timer.start();
+        SolverResult result;
+        if (m_board.isSolved())
+        {
+            result.status = SolverResult::Solved;
+            result.storedStates = 1;
+            return result;
+        }
+
+        bool complete = false;
+        for (quint64 width = qMax(1, m_options.beamWidth); !complete && !m_aborted; width *= 2)
+            complete = search(width);
+
+        if (!m_best.isEmpty())
+            result.status = SolverResult::Solved;
+        else
+            result.status = complete ? SolverResult::Unsolvable : SolverResult::Aborted;
+        result.moves = m_best;
+        result.expandedStates = m_expanded;
+        result.storedStates = m_stored;
+        return result;
+    }
+
+    /**
+     *  One beam search keeping width positions per depth, cut off where it
+     *  can't beat m_best any more
+     *  @return true if no position was dropped for the width, so that there
+     *  is no solution shorter than m_best
+     */
+    bool search(quint64 width)
+    {
+        std::vector<Node> nodes;
+        std::vector<Cell> cells;
+        std::vector<Candidate> candidates;
+        // kept positions by hash, told apart by their cells on collisions
+        Seen seen;
+
+        const Node start = { quint32(NoParent), 0, 0, 0 };
+        nodes.push_back(start);
+        cells = m_startCells;
+        m_board.assignCells(cells.data());
+        seen.insert(m_board.hash(), 0);
+
+        MoveList moves;
+        bool complete = true;
+        quint32 layerStart = 0;
+        for (int depth = 0; ; ++depth)
+        {
+            // a solution found below here would be no shorter
+            if (!m_best.isEmpty() && depth + 1 >= m_best.count())
+                return complete;
+
+            candidates.clear();
+            const quint32 layerEnd = nodes.size();
+            for (quint32 idx = layerStart; idx < layerEnd; ++idx)
+            {
+                const Cell* parentCells = &cells[size_t(idx) * m_atomCount];
+                m_board.assignCells(parentCells);
+                m_board.generateMoves(&moves);
+                if ((++m_expanded & 0xfff) == 0 && m_timer.elapsed() > qint64(m_timeLimit) * 1000)
+                {
+                    m_aborted = true;
+                    return false;
+                }
+
+                int distanceSum = 0;
+                for (int i = 0; i < m_atomCount; ++i)
+                    distanceSum += m_level->goalDistance(m_board.atomNum(i), parentCells[i]);
+
+                for (int m = 0; m < moves.count; ++m)
+                {
+                    const int atom = moves.atoms[m];
+                    const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                    const int num = m_board.atomNum(atom);
+                    const int oldDist = m_level->goalDistance(num, m_board.atomCell(atom));
+                    m_board.moveAtom(atom, dir, moves.distances[m]);
+
+                    Candidate candidate;
+                    candidate.cell = m_board.atomCell(atom);
+                    candidate.hash = m_board.hash();
+                    candidate.estimate = distanceSum - oldDist + m_level->goalDistance(num, candidate.cell);
+                    candidate.parent = idx;
+                    candidate.atom = atom;
+                    candidate.dir = dir;
+                    candidate.numCells = moves.distances[m];
+                    const bool solved = m_board.isSolved();
+                    m_board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+
+                    if (m_level->isDeadCell(num, candidate.cell)
+                        || isKnown(seen, cells, candidate.hash, parentCells, atom, candidate.cell))
+                        continue;
+                    if (solved)
+                    {
+                        // the first solution of a search is its shortest one
+                        improved(nodes, candidate);
+                        return complete;
+                    }
+                    // the goal distances never overestimate
+                    if (m_best.isEmpty() || depth + 1 + int(candidate.estimate) < m_best.count())
+                        candidates.push_back(candidate);
+                }
+            }
+            if (candidates.empty())
+                return complete;
+
+            std::sort(candidates.begin(), candidates.end());
+            layerStart = nodes.size();
+            for (size_t c = 0; c < candidates.size(); ++c)
+            {
+                const Candidate& candidate = candidates[c];
+                const Cell* parentCells = &cells[size_t(candidate.parent) * m_atomCount];
+                if (isKnown(seen, cells, candidate.hash, parentCells, candidate.atom, candidate.cell))
+                    continue;
+                if (nodes.size() - layerStart == width)
+                {
+                    complete = false;
+                    break;
+                }
+
+                const Node node = { candidate.parent, candidate.atom, candidate.dir, candidate.numCells };
+                nodes.push_back(node);
+                // resized first, inserting a range of cells into itself isn't allowed
+                const size_t offset = cells.size();
+                cells.resize(offset + m_atomCount);
+                std::copy(cells.begin() + size_t(candidate.parent) * m_atomCount,
+                          cells.begin() + size_t(candidate.parent + 1) * m_atomCount, cells.begin() + offset);
+                cells[offset + candidate.atom] = candidate.cell;
+                seen.insert(candidate.hash, quint32(nodes.size() - 1));
+            }
+            m_stored = qMax(m_stored, quint64(nodes.size()));
+
+            // roughly, hash set nodes take about four words each
+            const quint64 memory = quint64(nodes.capacity()) * sizeof(Node) + quint64(cells.capacity()) * sizeof(Cell)
+                + quint64(candidates.capacity()) * sizeof(Candidate) + quint64(seen.size()) * 4 * sizeof(void*);
+            if (memory > m_options.memoryLimit)
+            {
+                m_aborted = true;
+                return false;
+            }
+        }
+    }
+
+    /**
+     *  Whether the position reached from parentCells by moving atom to cell,
+     *  which hashes to hash, is one of the kept ones
+     */
+    bool isKnown(const Seen& seen, const std::vector<Cell>& cells, quint64 hash, const Cell* parentCells, int atom, int cell)
+    {
+        Seen::const_iterator it = seen.constFind(hash);
+        if (it == seen.constEnd())
+            return false;
+
+        memcpy(m_key.data(), parentCells, m_atomCount * sizeof(Cell));
+        m_key[atom] = cell;
+        m_classes.canonicalize(m_key.data());
+        for (; it != seen.constEnd() && it.key() == hash; ++it)
+        {
+            memcpy(m_other.data(), &cells[size_t(it.value()) * m_atomCount], m_atomCount * sizeof(Cell));
+            m_classes.canonicalize(m_other.data());
+            if (memcmp(m_key.data(), m_other.data(), m_atomCount * sizeof(Cell)) == 0)
+                return true;
+        }
+        return false;
+    }
+
+    /**
+     *  Makes the path to candidate, reached from the kept nodes, the best
+     *  solution and reports it
+     */
+    void improved(const std::vector<Node>& nodes, const Candidate& candidate)
+    {
+        QVector<SolverMove> moves;
+        SolverMove mv;
+        mv.atom = candidate.atom;
+        mv.dir = static_cast<KAtomic::Direction>(candidate.dir);
+        mv.numCells = candidate.numCells;
+        moves.prepend(mv);
+        for (quint32 s = candidate.parent; nodes[s].parent != NoParent; s = nodes[s].parent)
+        {
+            mv.atom = nodes[s].atom;
+            mv.dir = static_cast<KAtomic::Direction>(nodes[s].dir);
+            mv.numCells = nodes[s].numCells;
+            moves.prepend(mv);
+        }
+
+        m_best = moves;
+        if (m_options.progress)
+            m_options.progress->improved(m_best, m_timer.elapsed());
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    Board m_board;
+    const int m_atomCount;
+    const AtomClasses m_classes;
+    std::vector<Cell> m_startCells;
+    // canonical cells of the positions isKnown() compares
+    std::vector<Cell> m_key;
+    std::vector<Cell> m_other;
+    // seconds, see BeamSolver::DefaultTimeLimit
+    const int m_timeLimit;
+    QElapsedTimer m_timer;
+    QVector<SolverMove> m_best;
+    quint64 m_stored;
+    quint64 m_expanded;
+    bool m_aborted;
+};
+
+}
+
+SolverResult BeamSolver::solve(const LevelData* level)
+{
+    return searchOnBoard<BeamSearch>(level);
+}
@@ -0,0 +1,56 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_BEAMSOLVER_H
+#define KATOMIC_BEAMSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Anytime beam search for levels too large to solve exactly.
+ *
+ * Searches depth by depth like breadth-first search, but only keeps the
+ * SolverOptions::beamWidth positions of each depth whose atoms are closest
+ * to the molecule by LevelData::goalDistance(). Once a solution is found,
+ * the search starts over with twice the width, keeping only positions that
+ * could still lead to a shorter one, until the time budget runs out or a
+ * search drops no positions at all, which makes its solution optimal.
+ *
+ * Every shorter solution is passed to SolverOptions::progress as soon as it
+ * is found, and the shortest one is returned. Solutions are not optimal
+ * unless the search finished before the deadline.
+ */
+class BeamSolver : public Solver
+{
+public:
+    /**
+     *  Time budget in seconds when SolverOptions::timeLimit is 0. The widths
+     *  grow without end on levels too large to search completely, so the
+     *  search always needs a deadline
+     */
+    enum { DefaultTimeLimit = 60 };
+
+    explicit BeamSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+    bool isOptimal() const Q_DECL_OVERRIDE { return false; }
+};
+
+#endif
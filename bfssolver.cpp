@@ -0,0 +1,117 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "bfssolver.h"
+
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "atomclasses.h"
+#include "statetable.h"
+
+namespace
+{
+
+template<class Board>
+struct BreadthFirstSearch
+{
+    typedef typename Board::Cell Cell;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        QElapsedTimer timer;
+        timer.start();
+
+        SolverResult result;
+        Board board(level);
+        const int atomCount = board.atomCount();
+
+        // positions are stored in canonical form, see AtomClasses
+        const AtomClasses classes(board);
+        StateTable<Cell> table(atomCount);
+        std::vector<Cell> cells(atomCount);
+        std::vector<Cell> key(atomCount);
+        for (int i = 0; i < atomCount; ++i)
+            cells[i] = board.atomCell(i);
+        table.insert(classes.canonical(cells.data(), key.data(), atomCount), StateTable<Cell>::NoParent, 0);
+
+        if (board.isSolved())
+        {
+            result.status = SolverResult::Solved;
+            result.storedStates = 1;
+            return result;
+        }
+
+        MoveList moves;
+        result.status = SolverResult::Unsolvable;
+        // states are numbered in the order they were found, so each depth
+        // is a contiguous range of state numbers
+        for (quint32 idx = 0; idx < table.count(); ++idx)
+        {
+            memcpy(cells.data(), table.state(idx), atomCount * sizeof(Cell));
+            board.assignCells(cells.data());
+            board.generateMoves(&moves);
+            result.expandedStates++;
+
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                board.moveAtom(atom, dir, moves.distances[m]);
+                cells[atom] = board.atomCell(atom);
+
+                const quint32 child = Solver::movedToDeadCell(level, board, atom)
+                    ? quint32(StateTable<Cell>::NoParent)
+                    : table.insert(classes.canonical(cells.data(), key.data(), atomCount), idx, atom << 2 | dir);
+                if (child != StateTable<Cell>::NoParent && board.isSolved())
+                {
+                    result.status = SolverResult::Solved;
+                    result.storedStates = table.count();
+                    result.moves = AtomClasses::tablePath<Board>(level, table, child, atomCount);
+                    return result;
+                }
+
+                board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+                cells[atom] = board.atomCell(atom);
+            }
+
+            if (table.memoryUsage() > options.memoryLimit
+                || (options.timeLimit && (idx & 1023) == 0 && timer.elapsed() > options.timeLimit * 1000))
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+        }
+
+        result.storedStates = table.count();
+        return result;
+    }
+};
+
+}
+
+SolverResult BfsSolver::solve(const LevelData* level)
+{
+    SolverResult result = searchOnBoard<BreadthFirstSearch>(level);
+    completeMoves(level, &result.moves);
+    return result;
+}
@@ -0,0 +1,41 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_BFSSOLVER_H
+#define KATOMIC_BFSSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Breadth-first search over all positions reachable from the level's start.
+ *
+ * Returns a solution with the minimum number of moves. Positions are kept in
+ * a StateTable, whose insertion order doubles as the search queue, until the
+ * memory budget is used up.
+ */
+class BfsSolver : public Solver
+{
+public:
+    explicit BfsSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+};
+
+#endif
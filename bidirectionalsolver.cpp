@@ -0,0 +1,291 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "bidirectionalsolver.h"
+
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <vector>
+
+#include "atomclasses.h"
+#include "statetable.h"
+
+namespace
+{
+
+template<class Board>
+class BidirectionalSearch
+{
+public:
+    typedef typename Board::Cell Cell;
+    typedef StateTable<Cell> Table;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        BidirectionalSearch search(level, options);
+        return search.solve();
+    }
+
+private:
+    /**
+     * Positions found from one end. layerStarts[d] is the number of the
+     * first state at depth d, the last depth is the one to expand next
+     */
+    struct Side
+    {
+        explicit Side(int atomCount) : table(atomCount) {}
+
+        int depth(quint32 idx) const
+        {
+            return int(std::upper_bound(layerStarts.begin(), layerStarts.end(), idx) - layerStarts.begin()) - 1;
+        }
+        quint32 layerSize() const { return table.count() - layerStarts.back(); }
+
+        Table table;
+        std::vector<quint32> layerStarts;
+    };
+
+    enum { NoMeeting = 0x7fffffff };
+
+    BidirectionalSearch(const LevelData* level, const SolverOptions& options)
+        : m_level(level), m_options(options), m_board(level), m_atomCount(m_board.atomCount()),
+        m_classes(m_board), m_forward(m_atomCount), m_backward(m_atomCount), m_cells(m_atomCount), m_key(m_atomCount),
+        m_bestCost(NoMeeting), m_expanded(0), m_aborted(false)
+    {
+    }
+
+    SolverResult solve()
+    {
+        m_timer.start();
+        SolverResult result;
+
+        for (int i = 0; i < m_atomCount; ++i)
+            m_cells[i] = m_board.atomCell(i);
+        m_forward.table.insert(canonicalCells(), Table::NoParent, 0);
+        m_forward.layerStarts.push_back(0);
+        m_backward.layerStarts.push_back(0);
+        // without all of the molecule's atoms on the field there are no goal positions
+        if (m_atomCount == m_level->moleculeAtomCount())
+        {
+            QVector<int> atomNums(m_atomCount);
+            for (int atom = 0; atom < m_atomCount; ++atom)
+                atomNums[atom] = m_board.atomNum(atom);
+            for (int anchor = 0; anchor < m_level->goalAnchorCount() && !m_aborted; ++anchor)
+                addGoal(anchor, atomNums);
+        }
+
+        while (m_bestCost == NoMeeting && !m_aborted)
+        {
+            if (m_forward.layerSize() == 0 || m_backward.layerSize() == 0)
+                break;
+            if (m_forward.layerSize() <= m_backward.layerSize())
+                expandForward();
+            else
+                expandBackward();
+        }
+
+        if (m_bestCost != NoMeeting)
+        {
+            result.status = SolverResult::Solved;
+            result.moves = path();
+        }
+        else
+            result.status = m_aborted ? SolverResult::Aborted : SolverResult::Unsolvable;
+        result.expandedStates = m_expanded;
+        result.storedStates = m_forward.table.count() + m_backward.table.count();
+        return result;
+    }
+
+    /**
+     *  Adds the goal position for anchor to the backward side (see
+     *  LevelData::goalCells()). Identical atoms are interchangeable in
+     *  canonical form, so any order of them will do
+     */
+    void addGoal(int anchor, const QVector<int>& atomNums)
+    {
+        QVector<int> cells;
+        if (!m_level->goalCells(anchor, atomNums, &cells))
+            return;
+        std::copy(cells.constBegin(), cells.constEnd(), m_cells.begin());
+
+        const quint32 idx = m_backward.table.insert(canonicalCells(), Table::NoParent, 0);
+        if (idx != Table::NoParent)
+            added(m_backward, idx, m_forward);
+    }
+
+    const Cell* canonicalCells()
+    {
+        return m_classes.canonical(m_cells.data(), m_key.data(), m_atomCount);
+    }
+
+    /**
+     *  Called for every new state idx of side, looks it up on the other side
+     */
+    void added(const Side& side, quint32 idx, const Side& other)
+    {
+        const quint32 match = other.table.find(side.table.state(idx));
+        if (match != Table::NoParent)
+        {
+            const int cost = side.depth(idx) + other.depth(match);
+            if (cost < m_bestCost)
+            {
+                m_bestCost = cost;
+                m_meetForward = &side == &m_forward ? idx : match;
+                m_meetBackward = &side == &m_forward ? match : idx;
+            }
+        }
+        if (m_forward.table.memoryUsage() + m_backward.table.memoryUsage() > m_options.memoryLimit)
+            m_aborted = true;
+    }
+
+    void expandForward()
+    {
+        MoveList moves;
+        const quint32 begin = m_forward.layerStarts.back();
+        const quint32 end = m_forward.table.count();
+        m_forward.layerStarts.push_back(end);
+        for (quint32 idx = begin; idx < end && !m_aborted; ++idx)
+        {
+            memcpy(m_cells.data(), m_forward.table.state(idx), m_atomCount * sizeof(Cell));
+            m_board.assignCells(m_cells.data());
+            m_board.generateMoves(&moves);
+            m_expanded++;
+
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                m_board.moveAtom(atom, dir, moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+
+                // the backward side never gets to dead cells as it starts
+                // from the goals
+                const quint32 child = Solver::movedToDeadCell(m_level, m_board, atom)
+                    ? quint32(Table::NoParent) : m_forward.table.insert(canonicalCells(), idx, atom << 2 | dir);
+                if (child != Table::NoParent)
+                    added(m_forward, child, m_backward);
+
+                m_board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+            }
+            checkTime(idx);
+        }
+    }
+
+    /**
+     *  Expands the backward side's current depth. States there store the
+     *  forward move leading from them to their parent
+     */
+    void expandBackward()
+    {
+        MoveList moves;
+        const quint32 begin = m_backward.layerStarts.back();
+        const quint32 end = m_backward.table.count();
+        m_backward.layerStarts.push_back(end);
+        for (quint32 idx = begin; idx < end && !m_aborted; ++idx)
+        {
+            memcpy(m_cells.data(), m_backward.table.state(idx), m_atomCount * sizeof(Cell));
+            m_board.assignCells(m_cells.data());
+            m_board.generateReverseMoves(&moves);
+            m_expanded++;
+
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                const KAtomic::Direction back = BoardState::opposite(dir);
+                for (int numCells = 1; numCells <= moves.distances[m]; ++numCells)
+                {
+                    m_board.moveAtom(atom, back, numCells);
+                    m_cells[atom] = m_board.atomCell(atom);
+
+                    const quint32 child = m_backward.table.insert(canonicalCells(), idx, atom << 2 | dir);
+                    if (child != Table::NoParent)
+                        added(m_backward, child, m_forward);
+
+                    m_board.moveAtom(atom, dir, numCells);
+                    m_cells[atom] = m_board.atomCell(atom);
+                }
+            }
+            checkTime(idx);
+        }
+    }
+
+    void checkTime(quint32 idx)
+    {
+        if (m_options.timeLimit && (idx & 1023) == 0 && m_timer.elapsed() > m_options.timeLimit * 1000)
+            m_aborted = true;
+    }
+
+    /**
+     *  Moves from the start to the forward state where the sides met, then on
+     *  to the goal along the backward states
+     */
+    QVector<SolverMove> path() const
+    {
+        QVector<SolverMove> moves;
+        QVector<int> fromCells;
+        for (quint32 s = m_meetForward; m_forward.table.parent(s) != Table::NoParent; s = m_forward.table.parent(s))
+        {
+            const quint32 parent = m_forward.table.parent(s);
+            moves.prepend(AtomClasses::tableMove(m_forward.table.move(s)));
+            fromCells.prepend(AtomClasses::movedFromCell(m_forward.table.state(parent), m_forward.table.state(s), m_atomCount));
+        }
+        for (quint32 s = m_meetBackward; m_backward.table.parent(s) != Table::NoParent; s = m_backward.table.parent(s))
+        {
+            const quint32 parent = m_backward.table.parent(s);
+            moves.append(AtomClasses::tableMove(m_backward.table.move(s)));
+            fromCells.append(AtomClasses::movedFromCell(m_backward.table.state(s), m_backward.table.state(parent), m_atomCount));
+        }
+        Board start(m_level);
+        AtomClasses::resolveAtoms(&start, &moves, fromCells);
+        return moves;
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    Board m_board;
+    const int m_atomCount;
+    // both sides store positions in canonical form
+    const AtomClasses m_classes;
+    Side m_forward;
+    Side m_backward;
+    std::vector<Cell> m_cells;
+    // canonical form of m_cells
+    std::vector<Cell> m_key;
+    QElapsedTimer m_timer;
+    // cheapest meeting so far, as states of both sides
+    int m_bestCost;
+    quint32 m_meetForward;
+    quint32 m_meetBackward;
+    quint64 m_expanded;
+    bool m_aborted;
+};
+
+}
+
+SolverResult BidirectionalSolver::solve(const LevelData* level)
+{
+    SolverResult result = searchOnBoard<BidirectionalSearch>(level);
+    completeMoves(level, &result.moves);
+    return result;
+}
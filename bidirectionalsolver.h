@@ -0,0 +1,49 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_BIDIRECTIONALSOLVER_H
+#define KATOMIC_BIDIRECTIONALSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Breadth-first search from the start and, backwards, from all goal
+ * positions at once, until the two meet.
+ *
+ * Goal positions are the molecule at every feasible anchor, with identical
+ * atoms placed in every order. Going backwards, an atom can only have slid
+ * into its cell if the cell beyond it in the direction of the slide is
+ * blocked, and it may have come from any cell of the free run behind it.
+ *
+ * Each step expands a whole depth of the side with fewer positions at its
+ * current depth, and the search stops after the first step in which the
+ * sides meet, taking the shortest of the meetings of that step. Solutions
+ * therefore have the minimum number of moves, like BfsSolver's, while each
+ * side only goes about half as deep.
+ */
+class BidirectionalSolver : public Solver
+{
+public:
+    explicit BidirectionalSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+};
+
+#endif
@@ -0,0 +1,102 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_BITBOARD_H
+#define KATOMIC_BITBOARD_H
+
+#include <QtAlgorithms>
+#include <QtGlobal>
+
+/**
+ * One bit per cell of a W x H field, packed into 64-bit words.
+ * Bit numbering is the same as the board's cell numbering: cell = y*W + x.
+ *
+ * clearRunAfter() and clearRunBefore() find the nearest set bit in a cell
+ * range with a count-trailing/leading-zeros scan, so finding where a sliding
+ * atom stops doesn't depend on how far it slides. Ranges are at most one row
+ * long, so for fields up to 64 cells wide a scan touches one or two words.
+ */
+template<int W, int H>
+class Bitboard
+{
+public:
+    enum { NumCells = W*H, NumWords = (NumCells + 63) / 64 };
+
+    Bitboard() { clear(); }
+
+    void clear()
+    {
+        for (int i = 0; i < NumWords; ++i)
+            m_words[i] = 0;
+    }
+
+    bool testBit(int cell) const { return m_words[cell >> 6] & (Q_UINT64_C(1) << (cell & 63)); }
+    void setBit(int cell) { m_words[cell >> 6] |= Q_UINT64_C(1) << (cell & 63); }
+    void clearBit(int cell) { m_words[cell >> 6] &= ~(Q_UINT64_C(1) << (cell & 63)); }
+
+    /**
+     *  Number of unset bits following cell, up to the first set bit or up to
+     *  and including last, whichever comes first
+     */
+    int clearRunAfter(int cell, int last) const
+    {
+        const int from = cell + 1;
+        if (from > last)
+            return 0;
+
+        int w = from >> 6;
+        const int lastWord = last >> 6;
+        quint64 bits = m_words[w] & (~Q_UINT64_C(0) << (from & 63));
+        while (!bits)
+        {
+            if (w == lastWord)
+                return last - cell;
+            bits = m_words[++w];
+        }
+        return qMin((w << 6) + int(qCountTrailingZeroBits(bits)), last + 1) - cell - 1;
+    }
+
+    /**
+     *  Number of unset bits preceding cell, up to the first set bit or up to
+     *  and including first, whichever comes first
+     */
+    int clearRunBefore(int cell, int first) const
+    {
+        const int to = cell - 1;
+        if (to < first)
+            return 0;
+
+        int w = to >> 6;
+        const int firstWord = first >> 6;
+        quint64 bits = m_words[w] & (~Q_UINT64_C(0) >> (63 - (to & 63)));
+        while (!bits)
+        {
+            if (w == firstWord)
+                return cell - first;
+            bits = m_words[--w];
+        }
+        return cell - qMax((w << 6) + 63 - int(qCountLeadingZeroBits(bits)), first - 1) - 1;
+    }
+
+private:
+    quint64 m_words[NumWords];
+};
+
+#endif
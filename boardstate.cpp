@@ -0,0 +1,251 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "boardstate.h"
+
+#include <string.h>
+
+#include <QDebug>
+
+BoardState* BoardState::create(const LevelData* level)
+{
+    switch (level->boardSize())
+    {
+#define KATOMIC_CREATE_BOARD(N) \
+        case N: \
+            return new FixedBoardState<N, N>(level);
+        KATOMIC_FOR_EACH_BOARD_SIZE(KATOMIC_CREATE_BOARD)
+#undef KATOMIC_CREATE_BOARD
+    }
+    return new SparseBoardState(level);
+}
+
+template<int W, int H>
+void FixedBoardState<W, H>::setLevelData(const LevelData* level)
+{
+    Q_ASSERT(level->boardSize() == W);
+    m_level = level;
+
+    m_rows.clear();
+    m_columns.clear();
+    m_atomCount = 0;
+    foreach (const LevelData::Element& element, level->atomElements())
+    {
+        if (m_atomCount == MaxAtoms)
+        {
+            qWarning() << "too many atoms in level, ignoring the rest";
+            break;
+        }
+        m_atomCells[m_atomCount] = element.y*W + element.x;
+        m_atomNums[m_atomCount] = element.atom;
+        m_atomCount++;
+    }
+
+    memset(m_anchorHits, 0, sizeof(m_anchorHits));
+    m_solvedAnchors = 0;
+    m_requiredHits = m_atomCount == level->moleculeAtomCount() ? m_atomCount : -1;
+    m_hash = 0;
+    for (int i = 0; i < m_atomCount; ++i)
+        placeAtom(i);
+}
+
+template<int W, int H>
+void FixedBoardState<W, H>::setAtomPos(int idx, int x, int y)
+{
+    removeAtom(idx);
+    m_atomCells[idx] = y*W + x;
+    placeAtom(idx);
+}
+
+template<int W, int H>
+bool FixedBoardState<W, H>::containsWallAt(int x, int y) const
+{
+    return m_level->containsWallAt(x, y);
+}
+
+template<int W, int H>
+bool FixedBoardState<W, H>::cellIsEmpty(int x, int y) const
+{
+    return !m_level->containsWallAt(x, y) && !m_rows.testBit(y*W + x);
+}
+
+#define KATOMIC_INSTANTIATE_BOARD(N) template class FixedBoardState<N, N>;
+KATOMIC_FOR_EACH_BOARD_SIZE(KATOMIC_INSTANTIATE_BOARD)
+#undef KATOMIC_INSTANTIATE_BOARD
+
+// ==================================================
+
+SparseBoardState::SparseBoardState()
+    : m_level(0), m_solvedAnchors(0), m_requiredHits(-1), m_hash(0)
+{
+}
+
+SparseBoardState::SparseBoardState(const LevelData* level)
+    : m_level(0), m_solvedAnchors(0), m_requiredHits(-1), m_hash(0)
+{
+    setLevelData(level);
+}
+
+void SparseBoardState::setLevelData(const LevelData* level)
+{
+    m_level = level;
+
+    m_atoms.clear();
+    foreach (const LevelData::Element& element, level->atomElements())
+    {
+        Atom atom;
+        atom.x = element.x;
+        atom.y = element.y;
+        atom.num = element.atom;
+        m_atoms.append(atom);
+    }
+
+    m_anchorHits.clear();
+    m_solvedAnchors = 0;
+    m_requiredHits = m_atoms.count() == level->moleculeAtomCount() ? m_atoms.count() : -1;
+    m_hash = 0;
+    for (int i = 0; i < m_atoms.count(); ++i)
+        updateAtom(i, 1);
+}
+
+void SparseBoardState::setAtomPos(int idx, int x, int y)
+{
+    updateAtom(idx, -1);
+    m_atoms[idx].x = x;
+    m_atoms[idx].y = y;
+    updateAtom(idx, 1);
+}
+
+bool SparseBoardState::containsWallAt(int x, int y) const
+{
+    return m_level->containsWallAt(x, y);
+}
+
+bool SparseBoardState::cellIsEmpty(int x, int y) const
+{
+    if (m_level->containsWallAt(x, y))
+        return false;
+
+    foreach (const Atom& atom, m_atoms)
+    {
+        if (atom.x == x && atom.y == y)
+            return false;
+    }
+    return true;
+}
+
+int SparseBoardState::slideDistance(int idx, Direction dir) const
+{
+    // start with the distance to the nearest wall and shorten it
+    // for every atom in the way
+    const Atom& moving = m_atoms.at(idx);
+    int dist = m_level->wallDistance(moving.y * m_level->stride() + moving.x, dir);
+    foreach (const Atom& atom, m_atoms)
+    {
+        switch (dir)
+        {
+            case KAtomic::Up:
+                if (atom.x == moving.x && atom.y < moving.y)
+                    dist = qMin(dist, moving.y - atom.y - 1);
+                break;
+            case KAtomic::Down:
+                if (atom.x == moving.x && atom.y > moving.y)
+                    dist = qMin(dist, atom.y - moving.y - 1);
+                break;
+            case KAtomic::Left:
+                if (atom.y == moving.y && atom.x < moving.x)
+                    dist = qMin(dist, moving.x - atom.x - 1);
+                break;
+            case KAtomic::Right:
+                if (atom.y == moving.y && atom.x > moving.x)
+                    dist = qMin(dist, atom.x - moving.x - 1);
+                break;
+        }
+    }
+    return dist;
+}
+
+int SparseBoardState::applyMove(int idx, Direction dir)
+{
+    const int numCells = slideDistance(idx, dir);
+    moveAtom(idx, dir, numCells);
+    return numCells;
+}
+
+void SparseBoardState::undoMove(int idx, Direction dir, int numCells)
+{
+    moveAtom(idx, opposite(dir), numCells);
+}
+
+void SparseBoardState::moveAtom(int idx, Direction dir, int numCells)
+{
+    updateAtom(idx, -1);
+    m_atoms[idx].x += numCells*KAtomic::stepX(dir);
+    m_atoms[idx].y += numCells*KAtomic::stepY(dir);
+    updateAtom(idx, 1);
+}
+
+int SparseBoardState::generateMoves(MoveList* moves) const
+{
+    moves->count = 0;
+    for (int idx = 0; idx < m_atoms.count(); ++idx)
+        for (int dir = KAtomic::Up; dir <= KAtomic::Right; ++dir)
+        {
+            const int dist = slideDistance(idx, static_cast<Direction>(dir));
+            if (dist)
+                moves->append(idx, static_cast<Direction>(dir), dist);
+        }
+    return moves->count;
+}
+
+int SparseBoardState::generateReverseMoves(MoveList* moves) const
+{
+    moves->count = 0;
+    for (int idx = 0; idx < m_atoms.count(); ++idx)
+        for (int dir = KAtomic::Up; dir <= KAtomic::Right; ++dir)
+        {
+            if (slideDistance(idx, static_cast<Direction>(dir)) != 0)
+                continue;
+            const int run = slideDistance(idx, opposite(static_cast<Direction>(dir)));
+            if (run)
+                moves->append(idx, static_cast<Direction>(dir), run);
+        }
+    return moves->count;
+}
+
+void SparseBoardState::updateAtom(int idx, int delta)
+{
+    m_hash ^= m_level->zobristKey(m_atoms.at(idx).num, atomCell(idx));
+
+    int count;
+    const quint16* anchors = m_level->matchingGoalAnchors(m_atoms.at(idx).num, atomCell(idx), &count);
+    for (int i = 0; i < count; ++i)
+    {
+        int& hits = m_anchorHits[anchors[i]];
+        if (hits == m_requiredHits)
+            m_solvedAnchors--;
+        hits += delta;
+        if (hits == m_requiredHits)
+            m_solvedAnchors++;
+        if (hits == 0)
+            m_anchorHits.remove(anchors[i]);
+    }
+}
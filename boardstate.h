@@ -0,0 +1,473 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_BOARDSTATE_H
+#define KATOMIC_BOARDSTATE_H
+
+#include <QtGlobal>
+#include <QHash>
+#include <QVector>
+
+#include "commondefs.h"
+#include "bitboard.h"
+#include "levelset.h"
+
+/**
+ * Fixed capacity buffer of moves, filled by BoardState::generateMoves().
+ *
+ * Move i is (atoms[i], dirs[i], distances[i]). Fields are kept in separate
+ * arrays so scanning one of them touches only the memory it needs. The
+ * capacity covers every move of a level with the largest allowed number of
+ * atoms, so filling it never allocates.
+ */
+struct MoveList
+{
+    enum { Capacity = 255*4 };
+
+    int count;
+    quint8 atoms[Capacity];
+    quint8 dirs[Capacity];
+    /**
+     *  Number of cells the atom slides, never 0
+     */
+    quint8 distances[Capacity];
+
+    MoveList() : count(0) {}
+
+    void append(int atom, KAtomic::Direction dir, int distance)
+    {
+        atoms[count] = atom;
+        dirs[count] = dir;
+        distances[count] = distance;
+        count++;
+    }
+};
+
+/**
+ * Headless KAtomic position: atom cells and atom numbers, plus the rules
+ * to move atoms around. Knows nothing about scenes, items or animation.
+ *
+ * This is the interface PlayField works with. The actual boards are
+ * FixedBoardState specialisations, one per supported field size, and
+ * SparseBoardState for fields larger than all of them; create() picks the
+ * one matching the level. Analysis code that needs speed uses them directly,
+ * where all calls are resolved at compile time.
+ *
+ * Cells are numbered row by row with the level's stride:
+ * cell = y*LevelData::stride() + x.
+ */
+class BoardState
+{
+public:
+    typedef KAtomic::Direction Direction;
+
+    virtual ~BoardState() {}
+
+    /**
+     *  Creates the board specialisation suitable for level, set to the level's starting position
+     */
+    static BoardState* create(const LevelData* level);
+
+    virtual BoardState* clone() const = 0;
+
+    /**
+     *  Resets the board to the starting position of level
+     */
+    virtual void setLevelData(const LevelData* level) = 0;
+
+    /**
+     *  Number of atoms on the board
+     */
+    virtual int atomCount() const = 0;
+    /**
+     *  Atom number (index within Molecule's atoms) of atom idx
+     */
+    virtual int atomNum(int idx) const = 0;
+
+    virtual int atomCell(int idx) const = 0;
+    virtual int atomX(int idx) const = 0;
+    virtual int atomY(int idx) const = 0;
+    /**
+     *  Places atom idx at (x,y) without checking any rules. (x,y) must not hold another atom
+     */
+    virtual void setAtomPos(int idx, int x, int y) = 0;
+    /**
+     *  Places every atom idx at cells[idx] at once, without checking any rules
+     *  (used on game loading, where atoms may swap places)
+     */
+    virtual void setAtomCells(const int* cells) = 0;
+
+    /**
+     *  Returns true if (x,y) is a wall. Cells outside of the field count as walls
+     */
+    virtual bool containsWallAt(int x, int y) const = 0;
+    /**
+     *  Returns true if cell (x,y) is empty, i.e. it isn't a wall and has no atom
+     */
+    virtual bool cellIsEmpty(int x, int y) const = 0;
+
+    /**
+     *  Number of cells atom idx would slide in direction dir
+     */
+    virtual int slideDistance(int idx, Direction dir) const = 0;
+    virtual bool canMove(int idx, Direction dir) const = 0;
+    /**
+     *  Slides atom idx in direction dir as far as it goes
+     *  @return number of cells the atom has moved
+     */
+    virtual int applyMove(int idx, Direction dir) = 0;
+    /**
+     *  Reverts a move previously done by applyMove()
+     */
+    virtual void undoMove(int idx, Direction dir, int numCells) = 0;
+    /**
+     *  Moves atom idx by numCells in direction dir without checking any rules
+     *  (used when committing animated moves, undos and redos)
+     */
+    virtual void moveAtom(int idx, Direction dir, int numCells) = 0;
+
+    /**
+     *  Returns true if atoms form the level's molecule
+     */
+    virtual bool isSolved() const = 0;
+
+    /**
+     *  Zobrist hash of the position (see LevelData::zobristKey()). Positions
+     *  differing only by swapped atoms of the same kind hash the same
+     */
+    virtual quint64 hash() const = 0;
+
+    /**
+     *  Replaces the contents of moves with every legal move of the position,
+     *  ordered by atom, then by direction. A move is legal when the atom slides
+     *  at least one cell, using the same slideDistance() PlayField moves with
+     *  @return number of moves
+     */
+    virtual int generateMoves(MoveList* moves) const = 0;
+    /**
+     *  Replaces the contents of moves with the moves that can have led to the
+     *  position, ordered like generateMoves(). A slide in direction dirs[m]
+     *  only ends at the atom's cell if it is stopped there, so it came from
+     *  the free run behind the atom: moving the atom 1 to distances[m] cells
+     *  against dirs[m] gives each position the slide can have started from.
+     *  Used by searches backwards from the goals
+     *  @return number of moves
+     */
+    virtual int generateReverseMoves(MoveList* moves) const = 0;
+
+    static Direction opposite(Direction dir) { return static_cast<Direction>(dir ^ 1); }
+};
+
+// smallest unsigned type that can hold a cell number
+template<bool FitsInByte> struct BoardCellType { typedef quint8 Type; };
+template<> struct BoardCellType<false> { typedef quint16 Type; };
+
+/**
+ * BoardState specialised for a W x H field (W is the level's stride).
+ *
+ * Field size, cell arithmetic and bitboard loops are compile time constants,
+ * so the kernels below get fully unrolled. Instantiated for 8x8, 15x15,
+ * 32x32 and 64x64 (see KATOMIC_FOR_EACH_BOARD_SIZE).
+ *
+ * Slides are computed from the level's precomputed wall distances
+ * (see LevelData::wallDistance()) and atom occupancy bitboards, which give
+ * the nearest atom on the way without walking the field. Atoms are kept both
+ * in a row-major and in a column-major bitboard, so vertical slides are
+ * contiguous bit scans too.
+ *
+ * For every feasible goal anchor of the level (see LevelData::goalAnchorCount())
+ * the board counts atoms that are at their place relative to that anchor.
+ * The counts are updated on each move, so isSolved() is a simple comparison.
+ */
+template<int W, int H>
+class FixedBoardState Q_DECL_FINAL : public BoardState
+{
+public:
+    enum { Width = W, Height = H, NumCells = W*H, MaxAtoms = NumCells < 255 ? NumCells : 255 };
+    typedef typename BoardCellType<(NumCells <= 256)>::Type Cell;
+
+    FixedBoardState()
+        : m_level(0), m_atomCount(0), m_solvedAnchors(0), m_requiredHits(-1), m_hash(0)
+    {
+    }
+    explicit FixedBoardState(const LevelData* level)
+        : m_level(0), m_atomCount(0), m_solvedAnchors(0), m_requiredHits(-1), m_hash(0)
+    {
+        setLevelData(level);
+    }
+
+    BoardState* clone() const Q_DECL_OVERRIDE { return new FixedBoardState(*this); }
+    void setLevelData(const LevelData* level) Q_DECL_OVERRIDE;
+
+    int atomCount() const Q_DECL_OVERRIDE { return m_atomCount; }
+    int atomNum(int idx) const Q_DECL_OVERRIDE { return m_atomNums[idx]; }
+    int atomCell(int idx) const Q_DECL_OVERRIDE { return m_atomCells[idx]; }
+    int atomX(int idx) const Q_DECL_OVERRIDE { return m_atomCells[idx] % W; }
+    int atomY(int idx) const Q_DECL_OVERRIDE { return m_atomCells[idx] / W; }
+    void setAtomPos(int idx, int x, int y) Q_DECL_OVERRIDE;
+    void setAtomCells(const int* cells) Q_DECL_OVERRIDE { assignCells(cells); }
+
+    /**
+     *  setAtomCells() for any cell type. Only atoms whose cell changes are
+     *  touched, so search code can cheaply jump between related positions
+     */
+    template<typename C>
+    void assignCells(const C* cells)
+    {
+        // take all moved atoms off first, one may be going where another one was
+        for (int idx = 0; idx < m_atomCount; ++idx)
+            if (m_atomCells[idx] != cells[idx])
+                removeAtom(idx);
+        for (int idx = 0; idx < m_atomCount; ++idx)
+            if (m_atomCells[idx] != cells[idx])
+            {
+                m_atomCells[idx] = cells[idx];
+                placeAtom(idx);
+            }
+    }
+
+    bool containsWallAt(int x, int y) const Q_DECL_OVERRIDE;
+    bool cellIsEmpty(int x, int y) const Q_DECL_OVERRIDE;
+
+    int slideDistance(int idx, Direction dir) const Q_DECL_OVERRIDE
+    {
+        // walls never move, so how far the atom could go if there were no other atoms
+        // is known in advance. only the nearest atom on the way has to be looked for
+        const int cell = m_atomCells[idx];
+        const int wallDist = m_level->wallDistance(cell, dir);
+        switch (dir)
+        {
+            case KAtomic::Up:
+            {
+                const int tcell = transposed(cell);
+                return m_columns.clearRunBefore(tcell, tcell - wallDist);
+            }
+            case KAtomic::Down:
+            {
+                const int tcell = transposed(cell);
+                return m_columns.clearRunAfter(tcell, tcell + wallDist);
+            }
+            case KAtomic::Left:
+                return m_rows.clearRunBefore(cell, cell - wallDist);
+            case KAtomic::Right:
+                return m_rows.clearRunAfter(cell, cell + wallDist);
+        }
+        return 0;
+    }
+    bool canMove(int idx, Direction dir) const Q_DECL_OVERRIDE { return slideDistance(idx, dir) != 0; }
+    int applyMove(int idx, Direction dir) Q_DECL_OVERRIDE
+    {
+        const int numCells = slideDistance(idx, dir);
+        moveAtom(idx, dir, numCells);
+        return numCells;
+    }
+    void undoMove(int idx, Direction dir, int numCells) Q_DECL_OVERRIDE
+    {
+        moveAtom(idx, opposite(dir), numCells);
+    }
+    void moveAtom(int idx, Direction dir, int numCells) Q_DECL_OVERRIDE
+    {
+        removeAtom(idx);
+        m_atomCells[idx] += numCells * step(dir);
+        placeAtom(idx);
+    }
+
+    bool isSolved() const Q_DECL_OVERRIDE { return m_solvedAnchors != 0; }
+    quint64 hash() const Q_DECL_OVERRIDE { return m_hash; }
+
+    int generateMoves(MoveList* moves) const Q_DECL_OVERRIDE
+    {
+        moves->count = 0;
+        for (int idx = 0; idx < m_atomCount; ++idx)
+            for (int dir = KAtomic::Up; dir <= KAtomic::Right; ++dir)
+            {
+                const int dist = slideDistance(idx, static_cast<Direction>(dir));
+                if (dist)
+                    moves->append(idx, static_cast<Direction>(dir), dist);
+            }
+        return moves->count;
+    }
+    int generateReverseMoves(MoveList* moves) const Q_DECL_OVERRIDE
+    {
+        moves->count = 0;
+        for (int idx = 0; idx < m_atomCount; ++idx)
+            for (int dir = KAtomic::Up; dir <= KAtomic::Right; ++dir)
+            {
+                if (slideDistance(idx, static_cast<Direction>(dir)) != 0)
+                    continue;
+                const int run = slideDistance(idx, opposite(static_cast<Direction>(dir)));
+                if (run)
+                    moves->append(idx, static_cast<Direction>(dir), run);
+            }
+        return moves->count;
+    }
+
+    /**
+     *  Cell number change of moving one cell in direction dir
+     */
+    static int step(Direction dir)
+    {
+        return KAtomic::stepY(dir)*W + KAtomic::stepX(dir);
+    }
+
+private:
+    // number of cell in the column-major bitboard
+    static int transposed(int cell) { return (cell % W) * H + cell / W; }
+
+    void removeAtom(int idx)
+    {
+        updateGoalHits(idx, -1);
+        m_hash ^= m_level->zobristKey(m_atomNums[idx], m_atomCells[idx]);
+        m_rows.clearBit(m_atomCells[idx]);
+        m_columns.clearBit(transposed(m_atomCells[idx]));
+    }
+    void placeAtom(int idx)
+    {
+        m_rows.setBit(m_atomCells[idx]);
+        m_columns.setBit(transposed(m_atomCells[idx]));
+        m_hash ^= m_level->zobristKey(m_atomNums[idx], m_atomCells[idx]);
+        updateGoalHits(idx, 1);
+    }
+
+    /**
+     *  Adds delta to the hit count of every goal anchor atom idx matches
+     */
+    void updateGoalHits(int idx, int delta)
+    {
+        int count;
+        const quint16* anchors = m_level->matchingGoalAnchors(m_atomNums[idx], m_atomCells[idx], &count);
+        for (int i = 0; i < count; ++i)
+        {
+            quint8& hits = m_anchorHits[anchors[i]];
+            if (hits == m_requiredHits)
+                m_solvedAnchors--;
+            hits += delta;
+            if (hits == m_requiredHits)
+                m_solvedAnchors++;
+        }
+    }
+
+    const LevelData* m_level;
+
+    Cell m_atomCells[MaxAtoms];
+    quint8 m_atomNums[MaxAtoms];
+    int m_atomCount;
+    /**
+     *  Cells occupied by atoms, row by row and column by column
+     */
+    Bitboard<W, H> m_rows;
+    Bitboard<H, W> m_columns;
+
+    /**
+     *  Atoms at their molecule place, per goal anchor
+     */
+    quint8 m_anchorHits[NumCells];
+    /**
+     *  Number of anchors all atoms are placed around
+     */
+    int m_solvedAnchors;
+    /**
+     *  Hit count meaning that an anchor is solved. Can't be reached if atoms
+     *  on the field don't match the molecule's atom count
+     */
+    int m_requiredHits;
+    quint64 m_hash;
+};
+
+/**
+ * BoardState for fields too large for any FixedBoardState specialisation,
+ * up to MAX_FIELD_SIZE x MAX_FIELD_SIZE.
+ *
+ * Atoms are a plain position list and only goal anchors matched by some atom
+ * have a hit count, so the memory and the cost of a move grow with the number
+ * of atoms rather than with the field area.
+ */
+class SparseBoardState Q_DECL_FINAL : public BoardState
+{
+public:
+    typedef quint16 Cell;
+
+    SparseBoardState();
+    explicit SparseBoardState(const LevelData* level);
+
+    BoardState* clone() const Q_DECL_OVERRIDE { return new SparseBoardState(*this); }
+    void setLevelData(const LevelData* level) Q_DECL_OVERRIDE;
+
+    int atomCount() const Q_DECL_OVERRIDE { return m_atoms.count(); }
+    int atomNum(int idx) const Q_DECL_OVERRIDE { return m_atoms.at(idx).num; }
+    int atomCell(int idx) const Q_DECL_OVERRIDE { return m_atoms.at(idx).y * m_level->stride() + m_atoms.at(idx).x; }
+    int atomX(int idx) const Q_DECL_OVERRIDE { return m_atoms.at(idx).x; }
+    int atomY(int idx) const Q_DECL_OVERRIDE { return m_atoms.at(idx).y; }
+    void setAtomPos(int idx, int x, int y) Q_DECL_OVERRIDE;
+    void setAtomCells(const int* cells) Q_DECL_OVERRIDE { assignCells(cells); }
+
+    template<typename C>
+    void assignCells(const C* cells)
+    {
+        const int stride = m_level->stride();
+        for (int idx = 0; idx < m_atoms.count(); ++idx)
+            if (atomCell(idx) != cells[idx])
+                setAtomPos(idx, cells[idx] % stride, cells[idx] / stride);
+    }
+
+    bool containsWallAt(int x, int y) const Q_DECL_OVERRIDE;
+    bool cellIsEmpty(int x, int y) const Q_DECL_OVERRIDE;
+
+    int slideDistance(int idx, Direction dir) const Q_DECL_OVERRIDE;
+    bool canMove(int idx, Direction dir) const Q_DECL_OVERRIDE { return slideDistance(idx, dir) != 0; }
+    int applyMove(int idx, Direction dir) Q_DECL_OVERRIDE;
+    void undoMove(int idx, Direction dir, int numCells) Q_DECL_OVERRIDE;
+    void moveAtom(int idx, Direction dir, int numCells) Q_DECL_OVERRIDE;
+
+    bool isSolved() const Q_DECL_OVERRIDE { return m_solvedAnchors != 0; }
+    quint64 hash() const Q_DECL_OVERRIDE { return m_hash; }
+    int generateMoves(MoveList* moves) const Q_DECL_OVERRIDE;
+    int generateReverseMoves(MoveList* moves) const Q_DECL_OVERRIDE;
+
+private:
+    /**
+     *  Takes atom idx into account (delta 1) or out of it (delta -1) for goal hits and hash
+     */
+    void updateAtom(int idx, int delta);
+
+    struct Atom
+    {
+        quint8 x;
+        quint8 y;
+        quint8 num;
+    };
+
+    const LevelData* m_level;
+    QVector<Atom> m_atoms;
+    /**
+     *  Atoms at their molecule place, for goal anchors matched by at least one atom
+     */
+    QHash<int, int> m_anchorHits;
+    int m_solvedAnchors;
+    int m_requiredHits;
+    quint64 m_hash;
+};
+
+/**
+ * Expands M(size) for every board specialisation, e.g. for explicit template instantiations
+ */
+#define KATOMIC_FOR_EACH_BOARD_SIZE(M) M(8) M(15) M(32) M(64)
+
+#endif
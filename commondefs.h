@@ -18,7 +18,11 @@
 #ifndef KATOMIC_COMMONDEFS_H
 #define KATOMIC_COMMONDEFS_H
 
+#include <qnamespace.h>
+
 #define FIELD_SIZE 15
+// largest field a level may declare
+#define MAX_FIELD_SIZE 255
 
 #define DEFAULT_LEVELSET_NAME "default_levels"
 
@@ -33,6 +37,20 @@ namespace KAtomic
         LevelSetDescriptionRole = Qt::UserRole+3,
         LevelSetLevelCountRole = Qt::UserRole+4
     };
+
+    /**
+     * Directions in which atoms can be moved
+     */
+    enum Direction { Up=0, Down, Left, Right };
+
+    /**
+     * Column change of moving one cell in direction dir
+     */
+    inline int stepX(Direction dir) { return dir == Left ? -1 : dir == Right ? 1 : 0; }
+    /**
+     * Row change of moving one cell in direction dir
+     */
+    inline int stepY(Direction dir) { return dir == Up ? -1 : dir == Down ? 1 : 0; }
 } // namespace KAtomic
 
 #endif
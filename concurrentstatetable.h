@@ -0,0 +1,212 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_CONCURRENTSTATETABLE_H
+#define KATOMIC_CONCURRENTSTATETABLE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <string.h>
+#include <vector>
+
+/**
+ * StateTable that many threads can insert into at once, without locks.
+ *
+ * States live in arrays indexed by state number as in StateTable, but the
+ * numbers are handed out to each thread in chunks (see Cursor) so that
+ * threads write to their own part of the arrays. A thread writes a new
+ * position into its next free number and then publishes it by storing the
+ * number into an empty hash slot with compare-and-swap. If another thread
+ * published the same position first, the number is reused for the thread's
+ * next position. Slots also hold the upper half of the position's hash, so
+ * most mismatches are found without looking at the cells.
+ *
+ * The arrays can't move while threads insert, so insert() fails with Full
+ * when they run out and the caller has to stop all threads and call grow()
+ * before trying again. State numbers stay the same when growing. Unused
+ * numbers of the chunks are never filled in; count() is the number of
+ * positions actually stored.
+ */
+template<typename Cell>
+class ConcurrentStateTable
+{
+public:
+    enum
+    {
+        NoParent = 0xffffffff,
+        /**
+         *  Returned by insert() when the table needs to grow
+         */
+        Full = 0xfffffffe
+    };
+
+    /**
+     * State numbers one thread may use, each thread needs its own
+     */
+    struct Cursor
+    {
+        quint32 next;
+        quint32 end;
+
+        Cursor() : next(0), end(0) {}
+    };
+
+    explicit ConcurrentStateTable(int atomCount)
+        : m_atomCount(atomCount), m_count(0), m_reserved(0), m_capacity(0), m_slots(0), m_slotCount(0)
+    {
+    }
+    ~ConcurrentStateTable()
+    {
+        delete[] m_slots;
+    }
+
+    quint32 count() const { return m_count.load(std::memory_order_relaxed); }
+    const Cell* state(quint32 idx) const { return &m_cells[size_t(idx) * m_atomCount]; }
+    quint32 parent(quint32 idx) const { return m_parents[idx]; }
+    quint16 move(quint32 idx) const { return m_moves[idx]; }
+
+    /**
+     *  Bytes the table holds with slotCount hash slots
+     */
+    quint64 memoryUsage(quint64 slotCount) const
+    {
+        return slotCount * sizeof(quint64)
+            + capacityFor(slotCount) * (m_atomCount * sizeof(Cell) + sizeof(quint32) + sizeof(quint16));
+    }
+    quint64 memoryUsage() const { return memoryUsage(m_slotCount); }
+    quint64 slotCount() const { return m_slotCount; }
+
+    /**
+     *  Resizes the table to slotCount hash slots, a power of two larger than
+     *  the current one. Must not be called while threads are inserting.
+     */
+    void grow(quint64 slotCount)
+    {
+        m_capacity = quint32(capacityFor(slotCount));
+        m_cells.resize(size_t(m_capacity) * m_atomCount);
+        m_parents.resize(m_capacity);
+        m_moves.resize(m_capacity);
+
+        std::atomic<quint64>* slots = new std::atomic<quint64>[slotCount]();
+        const quint64 mask = slotCount - 1;
+        for (quint64 i = 0; i < m_slotCount; ++i)
+        {
+            const quint64 entry = m_slots[i].load(std::memory_order_relaxed);
+            if (entry == 0)
+                continue;
+            quint64 slot = (entry >> 32) & mask;
+            while (slots[slot].load(std::memory_order_relaxed) != 0)
+                slot = (slot + 1) & mask;
+            slots[slot].store(entry, std::memory_order_relaxed);
+        }
+        delete[] m_slots;
+        m_slots = slots;
+        m_slotCount = slotCount;
+    }
+
+    /**
+     *  Adds the position cells unless it is already known.
+     *  Safe to call from any number of threads with different cursors.
+     *  @return number of the added state, NoParent if it was known, or Full
+     */
+    quint32 insert(Cursor* cursor, const Cell* cells, quint32 parent, quint16 move)
+    {
+        if (cursor->next == cursor->end)
+        {
+            const quint32 begin = m_reserved.fetch_add(ChunkSize, std::memory_order_relaxed);
+            if (begin >= m_capacity || m_capacity - begin < ChunkSize)
+            {
+                // leave m_reserved as it is, the table is grown before it's used again
+                return Full;
+            }
+            cursor->next = begin;
+            cursor->end = begin + ChunkSize;
+        }
+
+        const quint32 idx = cursor->next;
+        memcpy(&m_cells[size_t(idx) * m_atomCount], cells, m_atomCount * sizeof(Cell));
+        m_parents[idx] = parent;
+        m_moves[idx] = move;
+
+        const quint64 tag = hashOf(cells) >> 32;
+        const quint64 newEntry = tag << 32 | (idx + 1);
+        const quint64 mask = m_slotCount - 1;
+        for (quint64 slot = tag & mask; ; slot = (slot + 1) & mask)
+        {
+            quint64 entry = m_slots[slot].load(std::memory_order_acquire);
+            if (entry == 0)
+            {
+                if (m_slots[slot].compare_exchange_strong(entry, newEntry, std::memory_order_acq_rel))
+                {
+                    cursor->next++;
+                    m_count.fetch_add(1, std::memory_order_relaxed);
+                    return idx;
+                }
+                // another thread took the slot, entry is now what it put there
+            }
+            if ((entry >> 32) == tag
+                && memcmp(state(quint32(entry) - 1), cells, m_atomCount * sizeof(Cell)) == 0)
+                return NoParent;
+        }
+    }
+
+    /**
+     *  Makes sure the next insert() calls don't fail because of chunks reserved
+     *  before a failed one. Must not be called while threads are inserting.
+     */
+    void resetReservations(std::vector<Cursor>* cursors)
+    {
+        quint32 end = 0;
+        for (size_t i = 0; i < cursors->size(); ++i)
+            end = qMax(end, (*cursors)[i].end);
+        m_reserved.store(end, std::memory_order_relaxed);
+    }
+
+private:
+    enum { ChunkSize = 1024 };
+
+    // the slots are at most 3/4 full
+    static quint64 capacityFor(quint64 slotCount)
+    {
+        return qMin(slotCount / 4 * 3, quint64(Full));
+    }
+
+    quint64 hashOf(const Cell* cells) const
+    {
+        quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+        for (int i = 0; i < m_atomCount; ++i)
+            h = (h ^ cells[i]) * Q_UINT64_C(0x100000001b3);
+        return h ^ (h >> 29);
+    }
+
+    int m_atomCount;
+    std::atomic<quint32> m_count;
+    std::atomic<quint32> m_reserved;
+    quint32 m_capacity;
+    std::vector<Cell> m_cells;
+    std::vector<quint32> m_parents;
+    std::vector<quint16> m_moves;
+    // open addressing, upper hash half << 32 | state number + 1, 0 for empty slots
+    std::atomic<quint64>* m_slots;
+    quint64 m_slotCount;
+};
+
+#endif
@@ -0,0 +1,572 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "externalbfssolver.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QTemporaryDir>
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+#include "atomclasses.h"
+
+// bytes read or written at a time, per file
+static const int BlockSize = 1 << 16;
+// runs merged at once, more are merged in several passes
+static const int MaxMergeWidth = 64;
+
+namespace
+{
+
+/**
+ * Reads a file of fixed size records front to back
+ */
+class RecordReader
+{
+public:
+    RecordReader(const QString& fileName, int recordSize)
+        : m_file(fileName), m_recordSize(recordSize), m_buffer(qMax(1, BlockSize / recordSize) * recordSize),
+        m_pos(0), m_end(0)
+    {
+    }
+
+    bool open() { return m_file.open(QIODevice::ReadOnly); }
+
+    /**
+     *  Next record, 0 at the end of the file. Valid until the next call
+     */
+    const char* next()
+    {
+        if (m_pos == m_end)
+        {
+            const qint64 size = m_file.read(m_buffer.data(), m_buffer.size());
+            if (size < m_recordSize)
+                return 0;
+            m_pos = 0;
+            m_end = size - size % m_recordSize;
+        }
+        const char* record = &m_buffer[m_pos];
+        m_pos += m_recordSize;
+        return record;
+    }
+
+private:
+    QFile m_file;
+    const int m_recordSize;
+    std::vector<char> m_buffer;
+    qint64 m_pos;
+    qint64 m_end;
+};
+
+/**
+ * Writes a file of fixed size records front to back
+ */
+class RecordWriter
+{
+public:
+    RecordWriter(const QString& fileName, int recordSize)
+        : m_file(fileName), m_recordSize(recordSize), m_buffer(qMax(1, BlockSize / recordSize) * recordSize),
+        m_fill(0), m_count(0), m_failed(false)
+    {
+    }
+
+    bool open() { return m_file.open(QIODevice::WriteOnly); }
+
+    void write(const char* record)
+    {
+        if (m_fill == int(m_buffer.size()))
+            flush();
+        memcpy(&m_buffer[m_fill], record, m_recordSize);
+        m_fill += m_recordSize;
+        m_count++;
+    }
+
+    /**
+     *  Writes out what is left and closes the file
+     *  @return false if anything couldn't be written
+     */
+    bool finish()
+    {
+        flush();
+        m_file.close();
+        return !m_failed;
+    }
+
+    quint64 count() const { return m_count; }
+
+private:
+    void flush()
+    {
+        if (m_fill && m_file.write(m_buffer.data(), m_fill) != m_fill)
+            m_failed = true;
+        m_fill = 0;
+    }
+
+    QFile m_file;
+    const int m_recordSize;
+    std::vector<char> m_buffer;
+    int m_fill;
+    quint64 m_count;
+    bool m_failed;
+};
+
+/**
+ * Sorted record files read as one sorted sequence without duplicates
+ */
+class RecordMerger
+{
+public:
+    RecordMerger(const QStringList& fileNames, int recordSize)
+        : m_recordSize(recordSize), m_current(recordSize), m_open(true)
+    {
+        foreach (const QString& fileName, fileNames)
+        {
+            RecordReader* reader = new RecordReader(fileName, recordSize);
+            m_readers.push_back(reader);
+            m_heads.push_back(0);
+            if (!reader->open())
+                m_open = false;
+            else if ((m_heads.back() = reader->next()))
+                m_heap.push_back(m_readers.size() - 1);
+        }
+        std::make_heap(m_heap.begin(), m_heap.end(), HeadOrder(this));
+    }
+    ~RecordMerger()
+    {
+        qDeleteAll(m_readers);
+    }
+
+    /**
+     *  False if some file couldn't be opened
+     */
+    bool isOpen() const { return m_open; }
+
+    /**
+     *  Next record, 0 after the last one. Valid until the next call
+     */
+    const char* next()
+    {
+        if (m_heap.empty())
+            return 0;
+        memcpy(m_current.data(), m_heads[m_heap.front()], m_recordSize);
+        do
+            advance();
+        while (!m_heap.empty() && memcmp(m_heads[m_heap.front()], m_current.data(), m_recordSize) == 0);
+        return m_current.data();
+    }
+
+private:
+    // orders m_heap so that the smallest head comes first
+    struct HeadOrder
+    {
+        explicit HeadOrder(const RecordMerger* merger) : m(merger) {}
+        bool operator()(size_t a, size_t b) const
+        {
+            return memcmp(m->m_heads[a], m->m_heads[b], m->m_recordSize) > 0;
+        }
+        const RecordMerger* m;
+    };
+
+    // moves the reader with the smallest head to its next record
+    void advance()
+    {
+        std::pop_heap(m_heap.begin(), m_heap.end(), HeadOrder(this));
+        const size_t idx = m_heap.back();
+        m_heads[idx] = m_readers[idx]->next();
+        if (m_heads[idx])
+            std::push_heap(m_heap.begin(), m_heap.end(), HeadOrder(this));
+        else
+            m_heap.pop_back();
+    }
+
+    const int m_recordSize;
+    std::vector<RecordReader*> m_readers;
+    std::vector<const char*> m_heads;
+    // readers with records left
+    std::vector<size_t> m_heap;
+    std::vector<char> m_current;
+    bool m_open;
+};
+
+template<class Board>
+class ExternalBreadthFirstSearch
+{
+public:
+    typedef typename Board::Cell Cell;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        ExternalBreadthFirstSearch search(level, options);
+        return search.solve();
+    }
+
+private:
+    ExternalBreadthFirstSearch(const LevelData* level, const SolverOptions& options)
+        : m_level(level), m_options(options), m_board(level), m_atomCount(m_board.atomCount()),
+        m_recordSize(m_atomCount * sizeof(Cell)), m_classes(m_board),
+        m_dir((options.scratchDir.isEmpty() ? QDir::tempPath() : options.scratchDir) + QStringLiteral("/katomic-solve-XXXXXX")),
+        m_cells(m_atomCount), m_key(m_atomCount), m_runCount(0), m_expanded(0), m_failed(false)
+    {
+        // half of the budget for the records, the rest for sorting them
+        // and for the file buffers
+        const quint64 records = m_options.memoryLimit / 2 / (m_recordSize + sizeof(quint32));
+        m_bufferLimit = size_t(qMax(quint64(1024), records)) * m_recordSize;
+        m_buffer.resize(qMin(m_bufferLimit, size_t(1024) * m_recordSize));
+        m_bufferFill = 0;
+    }
+
+    SolverResult solve()
+    {
+        m_timer.start();
+        SolverResult result;
+        if (!m_dir.isValid())
+        {
+            qWarning() << "can't create a directory for search files in" << m_options.scratchDir;
+            return result;
+        }
+
+        for (int i = 0; i < m_atomCount; ++i)
+            m_cells[i] = m_board.atomCell(i);
+        if (m_board.isSolved())
+        {
+            result.status = SolverResult::Solved;
+            result.storedStates = 1;
+            return result;
+        }
+        // nothing to move
+        if (m_atomCount == 0)
+        {
+            result.status = SolverResult::Unsolvable;
+            return result;
+        }
+
+        RecordWriter start(depthFile(0), m_recordSize);
+        if (!start.open())
+            return failed(result);
+        start.write(reinterpret_cast<const char*>(canonicalCells()));
+        if (!start.finish())
+            return failed(result);
+        m_depthFiles << depthFile(0);
+        m_closedFile = depthFile(0);
+        result.storedStates = 1;
+
+        for (;;)
+        {
+            QStringList runs;
+            const bool found = expand(&runs);
+            if (m_failed)
+                break;
+            if (found)
+            {
+                result.status = SolverResult::Solved;
+                result.moves = path();
+                break;
+            }
+            if (m_options.timeLimit && m_timer.elapsed() > m_options.timeLimit * 1000)
+                break;
+
+            const quint64 count = merge(runs);
+            if (m_failed)
+                break;
+            if (count == 0)
+            {
+                result.status = SolverResult::Unsolvable;
+                break;
+            }
+            result.storedStates += count;
+        }
+
+        if (m_failed)
+            return failed(result);
+        result.expandedStates = m_expanded;
+        return result;
+    }
+
+    SolverResult failed(SolverResult result) const
+    {
+        qWarning() << "can't write search files to" << m_dir.path();
+        result.status = SolverResult::Aborted;
+        return result;
+    }
+
+    QString depthFile(int depth) const { return m_dir.filePath(QStringLiteral("depth-%1").arg(depth)); }
+
+    /**
+     *  Expands the deepest depth file into sorted runs of successors
+     *  @return true if the molecule was found, its position is in m_cells
+     */
+    bool expand(QStringList* runs)
+    {
+        RecordReader reader(m_depthFiles.last(), m_recordSize);
+        if (!reader.open())
+        {
+            m_failed = true;
+            return false;
+        }
+
+        MoveList moves;
+        m_bufferFill = 0;
+        while (const char* record = reader.next())
+        {
+            memcpy(m_cells.data(), record, m_recordSize);
+            m_board.assignCells(m_cells.data());
+            m_board.generateMoves(&moves);
+            m_expanded++;
+
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                m_board.moveAtom(atom, dir, moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+                // earlier depths have no solved positions, so this one is new
+                if (m_board.isSolved())
+                    return true;
+
+                if (!Solver::movedToDeadCell(m_level, m_board, atom))
+                {
+                    // small levels never need the whole budget
+                    if (m_bufferFill == m_buffer.size() && m_buffer.size() < m_bufferLimit)
+                        m_buffer.resize(qMin(m_bufferLimit, m_buffer.size() * 2));
+                    else if (m_bufferFill == m_buffer.size())
+                        writeRun(runs);
+                    memcpy(&m_buffer[m_bufferFill], canonicalCells(), m_recordSize);
+                    m_bufferFill += m_recordSize;
+                }
+
+                m_board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+            }
+
+            if (m_options.timeLimit && (m_expanded & 1023) == 0 && m_timer.elapsed() > m_options.timeLimit * 1000)
+                return false;
+        }
+        if (m_bufferFill)
+            writeRun(runs);
+        return false;
+    }
+
+    /**
+     *  Sorts the buffered successors and writes them out as a run, without duplicates
+     */
+    void writeRun(QStringList* runs)
+    {
+        const quint32 count = m_bufferFill / m_recordSize;
+        std::vector<quint32> order(count);
+        for (quint32 i = 0; i < count; ++i)
+            order[i] = i;
+        const char* records = m_buffer.data();
+        const int size = m_recordSize;
+        std::sort(order.begin(), order.end(), [records, size](quint32 a, quint32 b) {
+            return memcmp(records + size_t(a) * size, records + size_t(b) * size, size) < 0;
+        });
+
+        const QString fileName = m_dir.filePath(QStringLiteral("run-%1").arg(m_runCount++));
+        RecordWriter writer(fileName, m_recordSize);
+        if (!writer.open())
+        {
+            m_failed = true;
+            return;
+        }
+        const char* last = 0;
+        for (quint32 i = 0; i < count; ++i)
+        {
+            const char* record = records + size_t(order[i]) * size;
+            if (!last || memcmp(last, record, size) != 0)
+                writer.write(record);
+            last = record;
+        }
+        if (!writer.finish())
+            m_failed = true;
+        runs->append(fileName);
+        m_bufferFill = 0;
+    }
+
+    /**
+     *  Merges runs into the next depth file, dropping positions of earlier
+     *  depths. Slides can't always be undone by the opposite slide, so
+     *  positions may turn up again at any later depth, not just two later.
+     *  The positions of all depths so far are kept merged in one closed
+     *  file, so this reads a single file for them however deep the search.
+     *  @return number of positions at the new depth
+     */
+    quint64 merge(QStringList runs)
+    {
+        while (runs.count() > MaxMergeWidth && !m_failed)
+        {
+            const QStringList group = runs.mid(0, MaxMergeWidth);
+            const QString fileName = m_dir.filePath(QStringLiteral("run-%1").arg(m_runCount++));
+            RecordMerger merger(group, m_recordSize);
+            RecordWriter writer(fileName, m_recordSize);
+            if (!merger.isOpen() || !writer.open())
+                m_failed = true;
+            while (const char* record = merger.next())
+                writer.write(record);
+            if (!writer.finish())
+                m_failed = true;
+            removeFiles(group);
+            runs = runs.mid(MaxMergeWidth, runs.count() - MaxMergeWidth);
+            runs.append(fileName);
+        }
+
+        const QString fileName = depthFile(m_depthFiles.count());
+        const QString closedFile = m_dir.filePath(QStringLiteral("closed-%1").arg(m_depthFiles.count()));
+        RecordMerger successors(runs, m_recordSize);
+        RecordReader known(m_closedFile, m_recordSize);
+        RecordWriter writer(fileName, m_recordSize);
+        RecordWriter closed(closedFile, m_recordSize);
+        if (m_failed || !successors.isOpen() || !known.open() || !writer.open() || !closed.open())
+        {
+            m_failed = true;
+            return 0;
+        }
+
+        const char* old = known.next();
+        while (const char* record = successors.next())
+        {
+            for (; old && memcmp(old, record, m_recordSize) < 0; old = known.next())
+                closed.write(old);
+            if (!old || memcmp(old, record, m_recordSize) != 0)
+            {
+                writer.write(record);
+                closed.write(record);
+            }
+        }
+        for (; old; old = known.next())
+            closed.write(old);
+        if (!writer.finish() || !closed.finish())
+            m_failed = true;
+        removeFiles(runs);
+        // the first closed file is the start's depth file, which path() needs
+        if (m_closedFile != depthFile(0))
+            QFile::remove(m_closedFile);
+        m_closedFile = closedFile;
+        m_depthFiles << fileName;
+        return writer.count();
+    }
+
+    const Cell* canonicalCells()
+    {
+        return m_classes.canonical(m_cells.data(), m_key.data(), m_atomCount);
+    }
+
+    static void removeFiles(const QStringList& fileNames)
+    {
+        foreach (const QString& fileName, fileNames)
+            QFile::remove(fileName);
+    }
+
+    /**
+     *  Moves to the solved position in m_cells, found by looking for the
+     *  position each one came from at the depths before it
+     */
+    QVector<SolverMove> path()
+    {
+        QVector<SolverMove> moves;
+        QVector<int> fromCells;
+        std::vector<Cell> target(m_cells);
+        m_classes.canonicalize(target.data());
+        MoveList list;
+        for (int depth = m_depthFiles.count() - 1; depth >= 0; --depth)
+        {
+            RecordReader reader(m_depthFiles.at(depth), m_recordSize);
+            if (!reader.open())
+            {
+                m_failed = true;
+                return QVector<SolverMove>();
+            }
+            bool found = false;
+            while (!found)
+            {
+                const char* record = reader.next();
+                if (!record)
+                {
+                    m_failed = true;
+                    return QVector<SolverMove>();
+                }
+                memcpy(m_cells.data(), record, m_recordSize);
+                m_board.assignCells(m_cells.data());
+                m_board.generateMoves(&list);
+                for (int m = 0; m < list.count && !found; ++m)
+                {
+                    const int atom = list.atoms[m];
+                    const KAtomic::Direction dir = static_cast<KAtomic::Direction>(list.dirs[m]);
+                    const int from = m_cells[atom];
+                    m_board.moveAtom(atom, dir, list.distances[m]);
+                    m_cells[atom] = m_board.atomCell(atom);
+                    if (memcmp(canonicalCells(), target.data(), m_recordSize) == 0)
+                    {
+                        SolverMove mv;
+                        mv.atom = atom;
+                        mv.dir = dir;
+                        mv.numCells = list.distances[m];
+                        moves.prepend(mv);
+                        fromCells.prepend(from);
+                        memcpy(target.data(), record, m_recordSize);
+                        found = true;
+                    }
+                    m_board.moveAtom(atom, BoardState::opposite(dir), list.distances[m]);
+                    m_cells[atom] = m_board.atomCell(atom);
+                }
+            }
+        }
+        Board start(m_level);
+        AtomClasses::resolveAtoms(&start, &moves, fromCells);
+        return moves;
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    Board m_board;
+    const int m_atomCount;
+    const int m_recordSize;
+    // records hold positions in canonical form
+    const AtomClasses m_classes;
+    QTemporaryDir m_dir;
+    // one file per depth, sorted
+    QStringList m_depthFiles;
+    // all positions of m_depthFiles, sorted
+    QString m_closedFile;
+    std::vector<Cell> m_cells;
+    // canonical form of m_cells
+    std::vector<Cell> m_key;
+    // successors not written to a run yet
+    std::vector<char> m_buffer;
+    size_t m_bufferFill;
+    // size m_buffer may grow to
+    size_t m_bufferLimit;
+    int m_runCount;
+    QElapsedTimer m_timer;
+    quint64 m_expanded;
+    bool m_failed;
+};
+
+}
+
+SolverResult ExternalBfsSolver::solve(const LevelData* level)
+{
+    return searchOnBoard<ExternalBreadthFirstSearch>(level);
+}
@@ -0,0 +1,50 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_EXTERNALBFSSOLVER_H
+#define KATOMIC_EXTERNALBFSSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Breadth-first search that keeps its positions on disk, for levels whose
+ * state space doesn't fit into memory.
+ *
+ * Each depth is a file of packed positions, sorted by their bytes, in a
+ * temporary directory under SolverOptions::scratchDir. Expanding a depth
+ * reads its file sequentially and collects successors in a buffer of about
+ * the memory budget, which is sorted and written out as a run whenever it
+ * fills up. Duplicates are removed after the whole depth is expanded, by
+ * merging the runs with each other and with the files of all earlier depths
+ * in one sequential pass, instead of looking positions up one by one.
+ *
+ * Files don't store how positions were reached. Once the molecule is found,
+ * the solution is recovered by scanning the depths backwards for a position
+ * that has a move to the next one of the path.
+ */
+class ExternalBfsSolver : public Solver
+{
+public:
+    explicit ExternalBfsSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+};
+
+#endif
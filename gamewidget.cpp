@@ -181,6 +181,7 @@ void GameWidget::switchToLevel (int l)
         m_level=l;
 
         m_playField->setLevelData(levelData);
+        m_playField->setTablebaseFileName(m_levelSet.tablebaseFileName(l));
 
         m_levelHighscore = m_highscore->levelHighscore( m_levelSet.name(), m_level );
 
@@ -230,7 +231,8 @@ void GameWidget::loadGame()
     {
         int l = gr.readEntry( "Level", 1 );
         switchToLevel(l);
-        m_playField->loadGame( gr );
+        if (!m_playField->loadGame( gr ))
+            KMessageBox::sorry(this, i18n("The saved game doesn't match level %1 of this level set, which may have changed since the game was saved.", l));
     }
 }
 
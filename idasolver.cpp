@@ -0,0 +1,84 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "idasolver.h"
+
+#include <QScopedPointer>
+
+#include "idastarsearch.h"
+
+namespace
+{
+
+template<class Board>
+struct IterativeDeepening
+{
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        PatternDatabaseBound* patterns = IdaStarSearch<Board>::createPatternBound(level, options);
+        IdaStarSearch<Board> search(level, options, patterns);
+        delete patterns;
+
+        SolverResult result;
+        result.status = SolverResult::Unsolvable;
+        const int start = search.startEstimate();
+        if (start >= AssignmentBound::Infinite)
+            return result;
+        QScopedPointer<TranspositionTable> table(options.transpositionTableSize ? new TranspositionTable(options.transpositionTableSize) : 0);
+        search.setTranspositionTable(table.data());
+
+        for (int bound = start; ; bound = search.nextBound())
+        {
+            if (search.isPastLongestPath(bound))
+                break;
+            if (options.maxDepth && bound > options.maxDepth)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            search.setBound(bound);
+            if (search.search(QVector<SolverMove>()))
+            {
+                result.status = SolverResult::Solved;
+                break;
+            }
+            if (search.isAborted())
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            if (search.nextBound() == IdaStarSearch<Board>::Infinite)
+                break;
+        }
+
+        result.moves = search.path();
+        result.expandedStates = search.expandedStates();
+        result.storedStates = result.moves.count();
+        return result;
+    }
+};
+
+}
+
+SolverResult IdaSolver::solve(const LevelData* level)
+{
+    return searchOnBoard<IterativeDeepening>(level);
+}
@@ -0,0 +1,48 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_IDASOLVER_H
+#define KATOMIC_IDASOLVER_H
+
+#include "solver.h"
+
+/**
+ * Iterative deepening A* search.
+ *
+ * Depth-first searches with a growing bound on moves made plus a lower bound
+ * of moves still needed, so memory use is linear in the solution length and
+ * solutions are still optimal. The lower bound is the sum of the atoms'
+ * LevelData::goalDistance(), which is admissible since a move moves one atom,
+ * or the tighter AssignmentBound where the field is small enough for it.
+ * Levels with many atoms also get pattern databases (PatternDatabaseBound),
+ * whichever bound is the highest is used.
+ *
+ * Positions reached again in an iteration are skipped with the help of a
+ * TranspositionTable of SolverOptions::transpositionTableSize bytes.
+ */
+class IdaSolver : public Solver
+{
+public:
+    explicit IdaSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+};
+
+#endif
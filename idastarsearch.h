@@ -0,0 +1,312 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_IDASTARSEARCH_H
+#define KATOMIC_IDASTARSEARCH_H
+
+#include <QElapsedTimer>
+
+#include <atomic>
+#include <vector>
+
+#include "assignmentbound.h"
+#include "patterndatabase.h"
+#include "solver.h"
+#include "stateranking.h"
+#include "transpositiontable.h"
+
+/**
+ * Depth-first search of IDA* iterations on a Board, used by IdaSolver and,
+ * one per thread, by ParallelIdaSolver.
+ *
+ * A search may start below the level's start position, after a given list
+ * of moves, so that an iteration can be split into parts searched
+ * separately. Searching up to a split depth collects the move lists of the
+ * positions at that depth instead of searching below them.
+ */
+template<class Board>
+class IdaStarSearch
+{
+public:
+    enum { Infinite = 0x7fffffff };
+
+    /**
+     *  @param patterns pattern database bound for the level, copied, or 0
+     */
+    IdaStarSearch(const LevelData* level, const SolverOptions& options, const PatternDatabaseBound* patterns)
+        : m_level(level), m_options(options), m_board(level), m_assignment(level),
+        m_patterns(patterns ? new PatternDatabaseBound(*patterns) : 0),
+        m_table(0), m_stop(0), m_cells(m_board.atomCount()), m_startCells(m_board.atomCount()),
+        m_tasks(0), m_splitDepth(-1), m_expanded(0), m_bound(0), m_nextBound(Infinite), m_longestPath(Infinite),
+        m_aborted(false)
+    {
+        for (int i = 0; i < m_board.atomCount(); ++i)
+            m_startCells[i] = m_board.atomCell(i);
+        // a shortest solution visits no position twice
+        const quint64 stateCount = StateRanking(level).stateCount();
+        if (stateCount && stateCount <= quint64(Infinite))
+            m_longestPath = int(stateCount - 1);
+        m_timer.start();
+    }
+    ~IdaStarSearch()
+    {
+        delete m_patterns;
+    }
+
+    /**
+     *  Pattern database bound to pass to the constructor as options ask for
+     *  it, 0 if they don't or the level's tables would be too large
+     */
+    static PatternDatabaseBound* createPatternBound(const LevelData* level, const SolverOptions& options)
+    {
+        // entries of one pattern database table, one byte each
+        static const quint64 MaxPatternTableSize = Q_UINT64_C(16) << 20;
+
+        if (options.patternDatabaseAtoms <= 0 || level->atomElements().count() < options.patternDatabaseAtoms)
+            return 0;
+        PatternDatabaseBound* patterns = new PatternDatabaseBound(level, options.patternDatabaseDir, MaxPatternTableSize);
+        if (!patterns->isUsable())
+        {
+            delete patterns;
+            return 0;
+        }
+        return patterns;
+    }
+
+    /**
+     *  Skips positions already searched according to table, which may be
+     *  shared with other searches
+     */
+    void setTranspositionTable(TranspositionTable* table) { m_table = table; }
+    /**
+     *  Makes the search give up, like on timeout, once stop is set
+     */
+    void setStopFlag(const std::atomic<bool>* stop) { m_stop = stop; }
+
+    /**
+     *  Lower bound of moves to solve the level, AssignmentBound::Infinite or
+     *  more if it can't be solved
+     */
+    int startEstimate()
+    {
+        int h;
+        return prepare(QVector<SolverMove>(), &h) ? estimate(h) : int(AssignmentBound::Infinite);
+    }
+
+    /**
+     *  Starts an iteration with bound, nextBound() is reset
+     */
+    void setBound(int bound)
+    {
+        m_bound = bound;
+        m_nextBound = Infinite;
+        // positions deeper than the bound aren't expanded
+        m_moveStack.resize(bound + 1);
+    }
+
+    /**
+     *  Searches the current iteration below the position reached by moves
+     *  (with numCells filled in), or only down to splitDepth if tasks is
+     *  given, appending the moves to the positions there to tasks.
+     *  @return true if a solution was found, see path()
+     */
+    bool search(const QVector<SolverMove>& moves, QVector<QVector<SolverMove> >* tasks = 0, int splitDepth = -1)
+    {
+        int h;
+        if (!prepare(moves, &h))
+            return false;
+        m_tasks = tasks;
+        m_splitDepth = tasks ? splitDepth : -1;
+        m_path = moves;
+        if (moves.isEmpty())
+            return search(0, h, -1, 0);
+        const SolverMove& last = moves.last();
+        return search(moves.count(), h, last.atom, last.dir, last.numCells);
+    }
+
+    /**
+     *  Smallest cost over the bound seen since setBound(), Infinite if none
+     */
+    int nextBound() const { return m_nextBound; }
+    /**
+     *  Whether an iteration with bound can't find anything the iterations
+     *  below it didn't, as it is longer than any shortest solution can be.
+     *  Levels with many positions never get there, see SolverOptions::maxDepth.
+     */
+    bool isPastLongestPath(int bound) const { return bound > m_longestPath; }
+    bool isAborted() const { return m_aborted; }
+    quint64 expandedStates() const { return m_expanded; }
+    /**
+     *  Moves of the solution found by search()
+     */
+    const QVector<SolverMove>& path() const { return m_path; }
+
+private:
+    /**
+     *  Sets up the board and bounds for the position reached by moves
+     *  @param distanceSum sum of the atoms' goal distances there
+     *  @return false if some atom can't reach the goal
+     */
+    bool prepare(const QVector<SolverMove>& moves, int* distanceSum)
+    {
+        m_board.assignCells(m_startCells.data());
+        foreach (const SolverMove& mv, moves)
+            m_board.moveAtom(mv.atom, mv.dir, mv.numCells);
+
+        *distanceSum = 0;
+        for (int i = 0; i < m_board.atomCount(); ++i)
+        {
+            m_cells[i] = m_board.atomCell(i);
+            const int dist = m_level->goalDistance(m_board.atomNum(i), m_cells[i]);
+            if (dist == LevelData::UnreachableGoal || m_level->isDeadCell(m_board.atomNum(i), m_cells[i]))
+                return false;
+            *distanceSum += dist;
+        }
+        if (m_assignment.isUsable())
+            m_assignment.reset(m_cells.data());
+        if (m_patterns)
+            m_patterns->reset(m_cells.data());
+        return true;
+    }
+
+    /**
+     *  Lower bound of moves left in the current position, given the sum of
+     *  its atoms' goal distances
+     */
+    int estimate(int distanceSum) const
+    {
+        int h = distanceSum;
+        if (m_assignment.isUsable())
+            h = qMax(h, m_assignment.value());
+        if (m_patterns)
+            h = qMax(h, m_patterns->value());
+        return h;
+    }
+
+    void updateBounds(int atom)
+    {
+        m_cells[atom] = m_board.atomCell(atom);
+        if (m_assignment.isUsable())
+            m_assignment.atomMoved(atom, m_cells.data());
+        if (m_patterns)
+            m_patterns->atomMoved(atom, m_cells.data());
+    }
+
+    /**
+     *  Searches below the current position, reached in g moves, whose atoms'
+     *  goal distances add up to distanceSum. lastAtom and lastDist describe
+     *  the move that led here, lastAtom is -1 at the start
+     */
+    bool search(int g, int distanceSum, int lastAtom, int lastDir, int lastDist = 0)
+    {
+        const int h = estimate(distanceSum);
+        if (g + h > m_bound)
+        {
+            m_nextBound = qMin(m_nextBound, g + h);
+            return false;
+        }
+        if (m_board.isSolved())
+            return true;
+        if (g == m_splitDepth)
+        {
+            m_tasks->append(m_path);
+            return false;
+        }
+        if (m_table && m_table->visit(m_board.hash(), m_bound, g))
+            return false;
+
+        if ((++m_expanded & 0xfff) == 0)
+        {
+            if ((m_stop && m_stop->load(std::memory_order_relaxed))
+                || (m_options.timeLimit && m_timer.elapsed() > m_options.timeLimit * 1000))
+                m_aborted = true;
+        }
+        if (m_aborted)
+            return false;
+
+        MoveList& moves = m_moveStack[g];
+        m_board.generateMoves(&moves);
+
+        for (int m = 0; m < moves.count; ++m)
+        {
+            const int atom = moves.atoms[m];
+            const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+            const int numCells = moves.distances[m];
+            // going straight back to the previous position
+            if (atom == lastAtom && dir == BoardState::opposite(static_cast<KAtomic::Direction>(lastDir)) && numCells == lastDist)
+                continue;
+
+            const int num = m_board.atomNum(atom);
+            const int oldDist = m_level->goalDistance(num, m_board.atomCell(atom));
+            m_board.moveAtom(atom, dir, numCells);
+            if (m_level->isDeadCell(num, m_board.atomCell(atom)))
+            {
+                m_board.moveAtom(atom, BoardState::opposite(dir), numCells);
+                continue;
+            }
+            const int newDist = m_level->goalDistance(num, m_board.atomCell(atom));
+            updateBounds(atom);
+
+            // atoms can't get to a cell they can't get back from, so newDist is reachable
+            SolverMove mv;
+            mv.atom = atom;
+            mv.dir = dir;
+            mv.numCells = numCells;
+            m_path.append(mv);
+            if (search(g + 1, distanceSum - oldDist + newDist, atom, dir, numCells))
+                return true;
+            m_path.removeLast();
+
+            m_board.moveAtom(atom, BoardState::opposite(dir), numCells);
+            m_cells[atom] = m_board.atomCell(atom);
+            if (m_assignment.isUsable())
+                m_assignment.undoMove();
+            if (m_patterns)
+                m_patterns->atomMoved(atom, m_cells.data());
+            if (m_aborted)
+                return false;
+        }
+        return false;
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    Board m_board;
+    AssignmentBound m_assignment;
+    PatternDatabaseBound* m_patterns;
+    TranspositionTable* m_table;
+    const std::atomic<bool>* m_stop;
+    // atom cells of m_board, as AssignmentBound wants them
+    std::vector<int> m_cells;
+    std::vector<int> m_startCells;
+    QElapsedTimer m_timer;
+    // moves of the positions on the current path, reused between iterations
+    std::vector<MoveList> m_moveStack;
+    QVector<SolverMove> m_path;
+    QVector<QVector<SolverMove> >* m_tasks;
+    int m_splitDepth;
+    quint64 m_expanded;
+    int m_bound;
+    int m_nextBound;
+    int m_longestPath;
+    bool m_aborted;
+};
+
+#endif
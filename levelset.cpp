@@ -36,21 +36,313 @@
 #include "molecule.h"
 #include "commondefs.h"
 
-LevelData::LevelData(const QList<Element>& elements, const Molecule* mol)
-    : m_molecule(mol)
+// side of the smallest board specialisation (see BoardState::create()) the field fits in,
+// 0 if there is none
+static int boardSizeFor(int width, int height)
 {
-    memset(m_field, 0, sizeof(m_field));
+    const int size = qMax(width, height);
+    if (size <= 8)
+        return 8;
+    if (size <= 15)
+        return 15;
+    if (size <= 32)
+        return 32;
+    if (size <= 64)
+        return 64;
+    return 0;
+}
+
+LevelData::LevelData(int width, int height, const QList<Element>& elements, const Molecule* mol)
+    : m_walls(width*height), m_width(width), m_height(height), m_molecule(mol),
+    m_goalAnchorCount(0), m_moleculeAtomCount(0), m_moleculeWidth(0), m_moleculeHeight(0),
+    m_maxAtomNum(0), m_moleculeKindCount(0)
+{
+    m_boardSize = boardSizeFor(m_width, m_height);
+    m_stride = m_boardSize ? m_boardSize : m_width;
+    m_cellCount = m_boardSize ? m_boardSize*m_boardSize : m_width*m_height;
+
     foreach (const Element& el, elements)
     {
         if (el.atom == -1)
         {
-            m_field[el.x][el.y] = true; // a wall
+            m_walls.setBit(el.y*m_width + el.x);
         }
         else
         {
             m_atoms.append(el);
         }
     }
+
+    computeWallDistances();
+    computeGoalAnchors();
+    computeZobristKeys();
+    computeGoalDistances();
+    computeDeadCells();
+}
+
+void LevelData::computeWallDistances()
+{
+    m_wallDistances.fill(0, m_cellCount*4);
+    for (int y = 0; y < m_height; ++y)
+        for (int x = 0; x < m_width; ++x)
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int dx = KAtomic::stepX(static_cast<KAtomic::Direction>(dir));
+                const int dy = KAtomic::stepY(static_cast<KAtomic::Direction>(dir));
+                int dist = 0;
+                while (!containsWallAt(x + (dist+1)*dx, y + (dist+1)*dy))
+                    dist++;
+                m_wallDistances[(y*m_stride + x)*4 + dir] = dist;
+            }
+}
+
+void LevelData::computeGoalAnchors()
+{
+    const int area = m_cellCount;
+
+    // molecule atoms, first relative to the molecule's grid...
+    int minI = MOLECULE_SIZE, minJ = MOLECULE_SIZE, maxI = -1, maxJ = -1;
+    for (int i = 0; i < MOLECULE_SIZE; ++i)
+        for (int j = 0; j < MOLECULE_SIZE; ++j)
+        {
+            int num = m_molecule->getAtom(i, j);
+            if (num == 0)
+                continue;
+            Element el;
+            el.atom = num;
+            el.x = i;
+            el.y = j;
+            m_moleculeAtoms.append(el);
+            minI = qMin(minI, i);
+            minJ = qMin(minJ, j);
+            maxI = qMax(maxI, i);
+            maxJ = qMax(maxJ, j);
+            m_maxAtomNum = qMax(m_maxAtomNum, num);
+        }
+    m_moleculeAtomCount = m_moleculeAtoms.count();
+
+    m_moleculeKinds.fill(-1, m_maxAtomNum + 1);
+    foreach (const Element& el, m_moleculeAtoms)
+    {
+        if (m_moleculeKinds.at(el.atom) < 0)
+            m_moleculeKinds[el.atom] = m_moleculeKindCount++;
+    }
+
+    // ...then to its bounding box
+    for (int i = 0; i < m_moleculeAtoms.count(); ++i)
+    {
+        m_moleculeAtoms[i].x -= minI;
+        m_moleculeAtoms[i].y -= minJ;
+    }
+    m_moleculeWidth = m_moleculeAtomCount ? maxI - minI + 1 : 0;
+    m_moleculeHeight = m_moleculeAtomCount ? maxJ - minJ + 1 : 0;
+    // a molecule without atoms can't be placed anywhere
+    const int lastAnchorY = m_moleculeAtomCount ? m_height - m_moleculeHeight : -1;
+
+    // bucket (atomNum, cell) -> anchors, counted first and filled afterwards
+    QVector<int> counts(m_moleculeKindCount * area, 0);
+    m_goalAnchorCells.clear();
+    for (int ay = 0; ay <= lastAnchorY; ++ay)
+        for (int ax = 0; ax <= m_width - m_moleculeWidth; ++ax)
+        {
+            bool fits = true;
+            foreach (const Element& el, m_moleculeAtoms)
+            {
+                if (containsWallAt(ax + el.x, ay + el.y))
+                {
+                    fits = false;
+                    break;
+                }
+            }
+            if (!fits)
+                continue;
+
+            m_goalAnchorCells.append(ay*m_stride + ax);
+            foreach (const Element& el, m_moleculeAtoms)
+                counts[moleculeKind(el.atom)*area + (ay + el.y)*m_stride + ax + el.x]++;
+        }
+    m_goalAnchorCount = m_goalAnchorCells.count();
+
+    m_goalAnchorOffsets.resize(counts.size() + 1);
+    m_goalAnchorOffsets[0] = 0;
+    for (int i = 0; i < counts.size(); ++i)
+        m_goalAnchorOffsets[i + 1] = m_goalAnchorOffsets[i] + counts[i];
+
+    m_goalAnchors.resize(m_goalAnchorOffsets.last());
+    QVector<int> fill = m_goalAnchorOffsets;
+    for (int k = 0; k < m_goalAnchorCount; ++k)
+    {
+        foreach (const Element& el, m_moleculeAtoms)
+            m_goalAnchors[fill[moleculeKind(el.atom)*area + m_goalAnchorCells.at(k) + el.y*m_stride + el.x]++] = k;
+    }
+}
+
+void LevelData::computeGoalDistances()
+{
+    m_goalDistances.fill(UnreachableGoal, m_moleculeKindCount * m_cellCount);
+    QVector<int> queue;
+    for (int num = 1; num <= m_maxAtomNum; ++num)
+    {
+        if (moleculeKind(num) < 0)
+            continue;
+        quint16* dist = m_goalDistances.data() + moleculeKind(num)*m_cellCount;
+
+        // breadth-first from all target cells at once. straight runs are
+        // reversible, so distances to the targets are distances from them
+        queue.clear();
+        for (int k = 0; k < m_goalAnchorCount; ++k)
+            foreach (const Element& el, m_moleculeAtoms)
+            {
+                const int cell = m_goalAnchorCells.at(k) + el.y*m_stride + el.x;
+                if (el.atom == num && dist[cell] != 0)
+                {
+                    dist[cell] = 0;
+                    queue.append(cell);
+                }
+            }
+
+        for (int head = 0; head < queue.count(); ++head)
+        {
+            const int cell = queue.at(head);
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int len = wallDistance(cell, static_cast<KAtomic::Direction>(dir));
+                const int step = this->step(static_cast<KAtomic::Direction>(dir));
+                for (int i = 1; i <= len; ++i)
+                {
+                    const int next = cell + i*step;
+                    if (dist[next] == UnreachableGoal)
+                    {
+                        dist[next] = dist[cell] + 1;
+                        queue.append(next);
+                    }
+                }
+            }
+        }
+    }
+}
+
+void LevelData::computeDeadCells()
+{
+    // cells any atom can ever stand on: the start cells and every cell where
+    // a slide from one of them can stop, i.e. in front of a wall or of a cell
+    // some other atom can stand on. Grown until nothing changes
+    QBitArray occupiable(m_cellCount);
+    foreach (const Element& el, m_atoms)
+        occupiable.setBit(el.y*m_stride + el.x);
+    for (bool changed = true; changed; )
+    {
+        changed = false;
+        for (int cell = 0; cell < m_cellCount; ++cell)
+        {
+            if (!occupiable.testBit(cell))
+                continue;
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int len = wallDistance(cell, static_cast<KAtomic::Direction>(dir));
+                const int step = this->step(static_cast<KAtomic::Direction>(dir));
+                for (int i = 1; i <= len; ++i)
+                {
+                    const int stop = cell + i*step;
+                    if (!occupiable.testBit(stop) && (i == len || occupiable.testBit(stop + step)))
+                    {
+                        occupiable.setBit(stop);
+                        changed = true;
+                    }
+                }
+            }
+        }
+    }
+
+    // per atom number, backwards from the places of feasible anchors whose
+    // cells can all be occupied, through the same stops
+    m_liveCells = QBitArray(m_moleculeKindCount * m_cellCount);
+    QVector<int> queue;
+    for (int num = 1; num <= m_maxAtomNum; ++num)
+    {
+        if (moleculeKind(num) < 0)
+            continue;
+        const int base = moleculeKind(num)*m_cellCount;
+        queue.clear();
+        for (int k = 0; k < m_goalAnchorCount; ++k)
+        {
+            bool feasible = true;
+            foreach (const Element& el, m_moleculeAtoms)
+                feasible = feasible && occupiable.testBit(m_goalAnchorCells.at(k) + el.y*m_stride + el.x);
+            if (!feasible)
+                continue;
+            foreach (const Element& el, m_moleculeAtoms)
+            {
+                const int cell = m_goalAnchorCells.at(k) + el.y*m_stride + el.x;
+                if (el.atom == num && !m_liveCells.testBit(base + cell))
+                {
+                    m_liveCells.setBit(base + cell);
+                    queue.append(cell);
+                }
+            }
+        }
+
+        for (int head = 0; head < queue.count(); ++head)
+        {
+            const int cell = queue.at(head);
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int step = this->step(static_cast<KAtomic::Direction>(dir));
+                // cell is where slides in dir stop if something holds them there
+                if (wallDistance(cell, static_cast<KAtomic::Direction>(dir)) != 0 && !occupiable.testBit(cell + step))
+                    continue;
+                // opposite direction, as in BoardState::opposite()
+                const int len = wallDistance(cell, static_cast<KAtomic::Direction>(dir ^ 1));
+                for (int i = 1; i <= len; ++i)
+                {
+                    const int from = cell - i*step;
+                    if (!m_liveCells.testBit(base + from))
+                    {
+                        m_liveCells.setBit(base + from);
+                        queue.append(from);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// splitmix64 finalizer: well spread 64 bits out of any input
+static quint64 mixBits(quint64 z)
+{
+    z = (z ^ (z >> 30)) * Q_UINT64_C(0xbf58476d1ce4e5b9);
+    z = (z ^ (z >> 27)) * Q_UINT64_C(0x94d049bb133111eb);
+    return z ^ (z >> 31);
+}
+
+void LevelData::computeZobristKeys()
+{
+    int maxNum = 0;
+    foreach (const Element& el, m_atoms)
+        maxNum = qMax(maxNum, el.atom);
+
+    m_zobristSlots.fill(0, maxNum + 1);
+    int slotCount = 0;
+    foreach (const Element& el, m_atoms)
+    {
+        if (m_zobristSlots[el.atom] == 0)
+            m_zobristSlots[el.atom] = ++slotCount;
+    }
+
+    // slot 0 is never used by an atom
+    m_zobristKeys.fill(0, (slotCount + 1) * m_cellCount);
+    for (int num = 0; num <= maxNum; ++num)
+    {
+        const int slot = m_zobristSlots.at(num);
+        if (slot == 0)
+            continue;
+        for (int y = 0; y < m_height; ++y)
+            for (int x = 0; x < m_width; ++x)
+            {
+                const quint64 seed = (quint64(num) << 16 | y << 8 | x) + 1;
+                m_zobristKeys[slot*m_cellCount + y*m_stride + x] = mixBits(seed * Q_UINT64_C(0x9e3779b97f4a7c15));
+            }
+    }
 }
 
 LevelData::~LevelData()
@@ -65,7 +357,15 @@ QList<LevelData::Element> LevelData::atomElements() const
 
 bool LevelData::containsWallAt(int x, int y) const
 {
-    return m_field[x][y];
+    if (x < 0 || y < 0 || x >= m_width || y >= m_height)
+        return true;
+
+    return m_walls.testBit(y*m_width + x);
+}
+
+int LevelData::wallStop(int cell, KAtomic::Direction dir) const
+{
+    return cell + wallDistance(cell, dir)*step(dir);
 }
 
 const Molecule* LevelData::molecule() const
@@ -73,6 +373,53 @@ const Molecule* LevelData::molecule() const
     return m_molecule;
 }
 
+bool LevelData::goalCells(int anchor, const QVector<int>& atomNums, QVector<int>* cells) const
+{
+    QBitArray used(m_moleculeAtoms.count());
+    cells->resize(atomNums.count());
+    for (int atom = 0; atom < atomNums.count(); ++atom)
+    {
+        int p = 0;
+        while (p < m_moleculeAtoms.count() && (used.testBit(p) || m_moleculeAtoms.at(p).atom != atomNums.at(atom)))
+            p++;
+        if (p == m_moleculeAtoms.count())
+            return false;
+        used.setBit(p);
+        (*cells)[atom] = m_goalAnchorCells.at(anchor) + m_moleculeAtoms.at(p).y*m_stride + m_moleculeAtoms.at(p).x;
+    }
+    return true;
+}
+
+int LevelData::goalAtomAt(int anchor, int x, int y) const
+{
+    const int anchorCell = m_goalAnchorCells.at(anchor);
+    const int i = x - anchorCell % m_stride;
+    const int j = y - anchorCell / m_stride;
+    if (i < 0 || j < 0 || i >= m_moleculeWidth || j >= m_moleculeHeight)
+        return 0;
+
+    foreach (const Element& el, m_moleculeAtoms)
+    {
+        if (el.x == i && el.y == j)
+            return el.atom;
+    }
+    return 0;
+}
+
+const quint16* LevelData::matchingGoalAnchors(int atomNum, int cell, int* count) const
+{
+    const int kind = moleculeKind(atomNum);
+    if (kind < 0)
+    {
+        *count = 0;
+        return 0;
+    }
+
+    const int bucket = kind*m_cellCount + cell;
+    *count = m_goalAnchorOffsets.at(bucket + 1) - m_goalAnchorOffsets.at(bucket);
+    return m_goalAnchors.constData() + m_goalAnchorOffsets.at(bucket);
+}
+
 // ==================================================
 
 LevelSet::LevelSet()
@@ -167,6 +514,13 @@ int LevelSet::levelCount() const
     return m_levelCount;
 }
 
+QString LevelSet::tablebaseFileName(int levelNum) const
+{
+    // installed level sets are usually in read-only directories
+    return QStandardPaths::writableLocation(QStandardPaths::AppDataLocation)
+        + QStringLiteral("/tablebases/%1-%2.tablebase").arg(m_name).arg(levelNum);
+}
+
 const LevelData* LevelSet::levelData(int levelNum) const
 {
     LevelData* data = m_levelCache.value(levelNum, 0);
@@ -178,16 +532,26 @@ const LevelData* LevelSet::readLevel(int levelNum) const
     KConfigGroup config = m_levelsFile->group("Level"+QString::number(levelNum));
     QString key;
 
+    // levels made for the classic field don't declare its size
+    const int width = config.readEntry("Width", FIELD_SIZE);
+    const int height = config.readEntry("Height", FIELD_SIZE);
+    if (width <= 0 || height <= 0 || width > MAX_FIELD_SIZE || height > MAX_FIELD_SIZE)
+    {
+        qDebug() << "invalid field size" << width << "x" << height << "of level" << levelNum << "in" << m_name;
+        return 0;
+    }
+
     QList<LevelData::Element> elements;
+    int atomCount = 0;
 
-    for (int j = 0; j < FIELD_SIZE; j++)
+    for (int j = 0; j < height; j++)
     {
         key.sprintf("feld_%02d", j);
         QString line = config.readEntry(key,QString());
 
-        for (int i = 0; i < FIELD_SIZE; i++)
+        for (int i = 0; i < width; i++)
         {
-            if (line.isEmpty())
+            if (i >= line.size())
             {
                 //qDebug() << "error while reading level" << levelNum << "data from" << m_name;
                 return 0;
@@ -211,12 +575,22 @@ const LevelData* LevelSet::readLevel(int levelNum) const
                 el.atom = atom2int(c.toLatin1());
 
                 elements.append(el);
+                atomCount++;
             }
         }
     }
 
+    // atoms are indexed with a byte in moves and board states
+    if (atomCount > 255)
+    {
+        qDebug() << "level" << levelNum << "in" << m_name << "has too many atoms";
+        return 0;
+    }
+
     // Molecule object will be deleted by LevelData, it takes ownership
-    LevelData* level = new LevelData(elements, readLevelMolecule(levelNum));
+    LevelData* level = new LevelData(width, height, elements, readLevelMolecule(levelNum));
+    if (level->goalAnchorCount() == 0)
+        qDebug() << "molecule of level" << levelNum << "in" << m_name << "fits nowhere on the field";
     m_levelCache[levelNum] = level;
 
     return level;
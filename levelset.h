@@ -25,6 +25,8 @@
 
 #include <QString>
 #include <QList>
+#include <QVector>
+#include <QBitArray>
 
 #include <KSharedConfig>
 
@@ -51,26 +53,195 @@ public:
 
     QList<Element> atomElements() const;
 
+    /**
+     * Field width, in cells
+     */
+    int width() const { return m_width; }
+    /**
+     * Field height, in cells
+     */
+    int height() const { return m_height; }
+    /**
+     * Side of the FixedBoardState specialisation chosen for this level
+     * (see BoardState::create()) or 0 if the field is too large for any of them
+     */
+    int boardSize() const { return m_boardSize; }
+    /**
+     * Row length of the cell numbers used by all per-cell data of this level:
+     * cell = y*stride() + x. It is boardSize() if there is one, so it may be
+     * larger than width(), and width() otherwise
+     */
+    int stride() const { return m_stride; }
+    /**
+     * Number of distinct cell numbers, i.e. the size of per-cell tables
+     */
+    int cellCount() const { return m_cellCount; }
+    /**
+     * Cell number change of moving one cell in direction dir
+     */
+    int step(KAtomic::Direction dir) const { return KAtomic::stepY(dir)*m_stride + KAtomic::stepX(dir); }
+
+    /**
+     * Returns true if (x,y) is a wall. Cells outside of the field count as walls
+     */
     bool containsWallAt(int x, int y) const;
 
+    /**
+     * Number of cells an atom starting from cell can move in direction dir
+     * if there are no other atoms on its way.
+     * Computed once per level since walls never move
+     */
+    int wallDistance(int cell, KAtomic::Direction dir) const { return m_wallDistances.at(cell*4 + dir); }
+    /**
+     * Cell where an atom starting from cell and moving in direction dir stops
+     * if there are no other atoms on its way
+     */
+    int wallStop(int cell, KAtomic::Direction dir) const;
+
     /**
      * A pointer to molecule object that is the target of this level
      */
     const Molecule* molecule() const;
 
+    /**
+     * Number of feasible goal anchors, i.e. translations of the molecule
+     * for which none of its atoms falls onto a wall or outside of the field.
+     * Anchors are numbered from 0, row by row
+     */
+    int goalAnchorCount() const { return m_goalAnchorCount; }
+    /**
+     * Cell of the top left corner of the molecule's bounding box when the
+     * molecule is placed at goal anchor anchor
+     */
+    int goalAnchorCell(int anchor) const { return m_goalAnchorCells.at(anchor); }
+    /**
+     * Atom number the molecule placed at goal anchor anchor has in cell (x,y),
+     * 0 if the molecule doesn't cover that cell
+     */
+    int goalAtomAt(int anchor, int x, int y) const;
+    /**
+     * Sets cells to where atoms with numbers atomNums stand when the molecule
+     * is made at goal anchor anchor, each atom on the first free place of its
+     * kind. Identical atoms can swap places, so this is every goal position
+     * of the anchor up to their order.
+     * @return false if the molecule has fewer places of some kind than atomNums
+     */
+    bool goalCells(int anchor, const QVector<int>& atomNums, QVector<int>* cells) const;
+
+    /**
+     * Atoms of the molecule with their position relative to the top left
+     * corner of its bounding box. Adding goalAnchorCell() gives the target
+     * cell of each of them for that anchor
+     */
+    const QList<Element>& moleculeAtoms() const { return m_moleculeAtoms; }
+    /**
+     * Number of atoms in the molecule
+     */
+    int moleculeAtomCount() const { return m_moleculeAtomCount; }
+    /**
+     * Size of the molecule's bounding box, in cells
+     */
+    int moleculeWidth() const { return m_moleculeWidth; }
+    int moleculeHeight() const { return m_moleculeHeight; }
+
+    /**
+     * Returns the goal anchors for which an atom with number atomNum
+     * standing in cell is at its place in the molecule.
+     * @param count is set to the number of returned anchors
+     */
+    const quint16* matchingGoalAnchors(int atomNum, int cell, int* count) const;
+
+    enum { UnreachableGoal = 0xffff };
+    /**
+     * Lower bound of the number of moves an atom with number atomNum needs
+     * to get from cell to a cell where it is part of the molecule at some
+     * feasible goal anchor. Other atoms are ignored, but as they could stop
+     * the atom anywhere, every straight wall-free run counts as one move.
+     * UnreachableGoal if there is no way there
+     */
+    int goalDistance(int atomNum, int cell) const
+    {
+        const int kind = moleculeKind(atomNum);
+        return kind >= 0 ? m_goalDistances.at(kind*m_cellCount + cell) : int(UnreachableGoal);
+    }
+
+    /**
+     * Whether an atom with number atomNum standing in cell can never reach a
+     * place in the molecule again. Unlike goalDistance(), slides only stop at
+     * walls and at cells some atom of the level can ever stand on, so this
+     * also catches cells an atom can enter but not leave towards a target.
+     * Positions with an atom in a dead cell can be dropped by any search
+     */
+    bool isDeadCell(int atomNum, int cell) const
+    {
+        const int kind = moleculeKind(atomNum);
+        return kind < 0 || !m_liveCells.testBit(kind*m_cellCount + cell);
+    }
+
+    /**
+     * Random key of an atom with number atomNum standing in cell. The hash of
+     * a position is the XOR of the keys of all its atoms (Zobrist hashing), so
+     * atoms with the same number are interchangeable and a move changes the
+     * hash by two XORs. Keys only depend on atom number and coordinates, so
+     * hashes stay the same between runs
+     */
+    quint64 zobristKey(int atomNum, int cell) const { return m_zobristKeys.at(m_zobristSlots.at(atomNum)*m_cellCount + cell); }
+
 private:
     friend class LevelSet;
 
+    // @param width, height - field size, at most MAX_FIELD_SIZE
     // @param elements contain atoms and walls. for walls 'atom' field will be -1
     // @param molecule - molecule to be solved. LevelData takes ownership of this object and will
     // delete it
-    LevelData(const QList<Element>& elements, const Molecule* mol);
+    LevelData(int width, int height, const QList<Element>& elements, const Molecule* mol);
     LevelData(const LevelData&);
 
+    void computeWallDistances();
+    void computeGoalAnchors();
+    void computeZobristKeys();
+    void computeGoalDistances();
+    void computeDeadCells();
+    // index of the molecule's atom kind atomNum in the per-kind tables, -1 if
+    // the molecule has no such atom
+    int moleculeKind(int atomNum) const { return atomNum > 0 && atomNum <= m_maxAtomNum ? m_moleculeKinds.at(atomNum) : -1; }
+
     QList<Element> m_atoms;
-    bool m_field[FIELD_SIZE][FIELD_SIZE];
+    // one bit per cell (y*m_width + x), set for walls
+    QBitArray m_walls;
+    int m_width;
+    int m_height;
+    int m_boardSize;
+    int m_stride;
+    int m_cellCount;
+    // wallDistance() for (cell, dir) is at cell*4 + dir
+    QVector<quint8> m_wallDistances;
 
     const Molecule* m_molecule;
+
+    int m_goalAnchorCount;
+    QVector<int> m_goalAnchorCells;
+    QList<Element> m_moleculeAtoms;
+    int m_moleculeAtomCount;
+    int m_moleculeWidth;
+    int m_moleculeHeight;
+    int m_maxAtomNum;
+    // moleculeKind() by atom number, and the number of kinds. Per-kind tables
+    // take kindCount*m_cellCount entries, however the atoms are numbered
+    QVector<int> m_moleculeKinds;
+    int m_moleculeKindCount;
+    // matchingGoalAnchors() lists, all packed in m_goalAnchors. Anchors for
+    // (atomNum, cell) start at m_goalAnchorOffsets[moleculeKind(atomNum)*m_cellCount + cell]
+    QVector<int> m_goalAnchorOffsets;
+    QVector<quint16> m_goalAnchors;
+    // zobristKey() for (atomNum, cell) is at m_zobristSlots[atomNum]*m_cellCount + cell,
+    // with one slot per atom number present in the level
+    QVector<int> m_zobristSlots;
+    QVector<quint64> m_zobristKeys;
+    // goalDistance() for (atomNum, cell) is at moleculeKind(atomNum)*m_cellCount + cell
+    QVector<quint16> m_goalDistances;
+    // one bit per (atomNum, cell) at moleculeKind(atomNum)*m_cellCount + cell, set unless isDeadCell()
+    QBitArray m_liveCells;
 };
 
 /**
@@ -118,6 +289,12 @@ public:
      */
     int levelCount() const;
 
+    /**
+     * @return file the tablebase of level levelNum (see Tablebase) is kept
+     * in, in the user's data directory
+     */
+    QString tablebaseFileName(int levelNum) const;
+
     /**
      * Checks if default level set is installed on disk
      */
@@ -0,0 +1,271 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "parallelbfssolver.h"
+
+#include <QElapsedTimer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+#include <atomic>
+#include <vector>
+
+#include "atomclasses.h"
+#include "concurrentstatetable.h"
+
+namespace
+{
+
+template<class Board>
+class ParallelBreadthFirstSearch
+{
+public:
+    typedef typename Board::Cell Cell;
+    typedef ConcurrentStateTable<Cell> Table;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        ParallelBreadthFirstSearch search(level, options);
+        return search.solve();
+    }
+
+private:
+    ParallelBreadthFirstSearch(const LevelData* level, const SolverOptions& options)
+        : m_level(level), m_options(options), m_atomCount(Board(level).atomCount()), m_classes(Board(level)),
+        m_table(m_atomCount),
+        m_threadCount(options.threadCount > 0 ? options.threadCount : qMax(1, QThread::idealThreadCount())),
+        m_cursors(m_threadCount), m_outputs(m_threadCount), m_expanded(0)
+    {
+        // thread 0 is the calling one, the pool runs the others
+        m_pool.setMaxThreadCount(qMax(1, m_threadCount - 1));
+    }
+
+    // frontier positions a thread takes at a time
+    enum { SliceSize = 256 };
+
+    SolverResult solve()
+    {
+        m_timer.start();
+
+        SolverResult result;
+        Board board(m_level);
+        quint64 slotCount = 1 << 16;
+        while (m_table.memoryUsage(slotCount) < m_options.memoryLimit / 64
+               || slotCount / 2 < quint64(m_threadCount) * 2048)
+            slotCount *= 2;
+        m_table.grow(slotCount);
+
+        std::vector<Cell> cells(m_atomCount);
+        std::vector<Cell> key(m_atomCount);
+        for (int i = 0; i < m_atomCount; ++i)
+            cells[i] = board.atomCell(i);
+        m_frontier.push_back(m_table.insert(&m_cursors[0], m_classes.canonical(cells.data(), key.data(), m_atomCount),
+                                            Table::NoParent, 0));
+
+        if (board.isSolved())
+        {
+            result.status = SolverResult::Solved;
+            result.storedStates = 1;
+            return result;
+        }
+
+        result.status = SolverResult::Unsolvable;
+        m_found = Table::NoParent;
+        while (!m_frontier.empty())
+        {
+            if (m_table.memoryUsage(slotCount) + queueMemoryUsage() > m_options.memoryLimit)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+
+            // a depth usually has a few times as many positions as the one
+            // before, so grow ahead to avoid expanding it twice
+            while (m_table.memoryUsage(slotCount * 2) + queueMemoryUsage() <= m_options.memoryLimit
+                   && slotCount / 4 * 3 < m_table.count() + quint64(m_frontier.size()) * 4)
+            {
+                slotCount *= 2;
+                m_table.grow(slotCount);
+            }
+
+            m_stop = false;
+            m_full = false;
+            m_aborted = false;
+            m_nextSlice = 0;
+            m_expanded = 0;
+
+            for (int t = 1; t < m_threadCount; ++t)
+                QtConcurrent::run(&m_pool, this, &ParallelBreadthFirstSearch::expand, t);
+            expand(0);
+            m_pool.waitForDone();
+            // a depth cut short by a full table is expanded again below
+            if (!m_full)
+                result.expandedStates += m_expanded;
+
+            if (m_found != Table::NoParent)
+            {
+                result.status = SolverResult::Solved;
+                result.moves = AtomClasses::tablePath<Board>(m_level, m_table, m_found, m_atomCount);
+                break;
+            }
+            if (m_aborted)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            if (m_full)
+            {
+                // expand the whole depth again once there is room, positions
+                // already added are known by then and aren't collected twice
+                slotCount *= 2;
+                if (m_table.memoryUsage(slotCount) + queueMemoryUsage() > m_options.memoryLimit)
+                {
+                    result.status = SolverResult::Aborted;
+                    break;
+                }
+                m_table.grow(slotCount);
+                m_table.resetReservations(&m_cursors);
+                continue;
+            }
+
+            m_frontier.clear();
+            for (int t = 0; t < m_threadCount; ++t)
+            {
+                m_frontier.insert(m_frontier.end(), m_outputs[t].begin(), m_outputs[t].end());
+                m_outputs[t].clear();
+            }
+        }
+
+        result.storedStates = m_table.count();
+        return result;
+    }
+
+    /**
+     *  Bytes held by the frontier and the threads' outputs, which hold about
+     *  as many positions as the table on levels with wide depths
+     */
+    quint64 queueMemoryUsage() const
+    {
+        quint64 capacity = m_frontier.capacity();
+        for (int t = 0; t < m_threadCount; ++t)
+            capacity += m_outputs[t].capacity();
+        return capacity * sizeof(quint32);
+    }
+
+    /**
+     *  Body of thread number thread: expands slices of m_frontier until all
+     *  are taken or the search has to stop
+     */
+    void expand(int thread)
+    {
+        Board board(m_level);
+        std::vector<Cell> cells(m_atomCount);
+        std::vector<Cell> key(m_atomCount);
+        MoveList moves;
+        typename Table::Cursor* cursor = &m_cursors[thread];
+        std::vector<quint32>& output = m_outputs[thread];
+        quint64 expanded = 0;
+
+        while (!m_stop.load(std::memory_order_relaxed))
+        {
+            const size_t begin = m_nextSlice.fetch_add(SliceSize, std::memory_order_relaxed);
+            if (begin >= m_frontier.size())
+                break;
+            const size_t end = qMin(begin + SliceSize, m_frontier.size());
+
+            for (size_t i = begin; i < end && !m_stop.load(std::memory_order_relaxed); ++i)
+            {
+                const quint32 idx = m_frontier[i];
+                memcpy(cells.data(), m_table.state(idx), m_atomCount * sizeof(Cell));
+                board.assignCells(cells.data());
+                board.generateMoves(&moves);
+                expanded++;
+
+                for (int m = 0; m < moves.count; ++m)
+                {
+                    const int atom = moves.atoms[m];
+                    const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                    board.moveAtom(atom, dir, moves.distances[m]);
+                    cells[atom] = board.atomCell(atom);
+
+                    const quint32 child = Solver::movedToDeadCell(m_level, board, atom)
+                        ? quint32(Table::NoParent)
+                        : m_table.insert(cursor, m_classes.canonical(cells.data(), key.data(), m_atomCount), idx, atom << 2 | dir);
+                    if (child == Table::Full)
+                    {
+                        m_full = true;
+                        m_stop = true;
+                        break;
+                    }
+                    if (child != Table::NoParent)
+                    {
+                        output.push_back(child);
+                        quint32 none = Table::NoParent;
+                        if (board.isSolved() && m_found.compare_exchange_strong(none, child))
+                            m_stop = true;
+                    }
+
+                    board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+                    cells[atom] = board.atomCell(atom);
+                }
+            }
+
+            if (thread == 0 && m_options.timeLimit && m_timer.elapsed() > m_options.timeLimit * 1000)
+            {
+                m_aborted = true;
+                m_stop = true;
+            }
+        }
+
+        m_expanded.fetch_add(expanded, std::memory_order_relaxed);
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    const int m_atomCount;
+    // positions are stored in canonical form
+    const AtomClasses m_classes;
+    Table m_table;
+    const int m_threadCount;
+    QThreadPool m_pool;
+    std::vector<typename Table::Cursor> m_cursors;
+    // positions each thread added at the next depth
+    std::vector<std::vector<quint32> > m_outputs;
+    std::vector<quint32> m_frontier;
+    QElapsedTimer m_timer;
+    std::atomic<size_t> m_nextSlice;
+    std::atomic<quint32> m_found;
+    // positions expanded at the current depth
+    std::atomic<quint64> m_expanded;
+    std::atomic<bool> m_stop;
+    std::atomic<bool> m_full;
+    std::atomic<bool> m_aborted;
+};
+
+}
+
+SolverResult ParallelBfsSolver::solve(const LevelData* level)
+{
+    SolverResult result = searchOnBoard<ParallelBreadthFirstSearch>(level);
+    completeMoves(level, &result.moves);
+    return result;
+}
@@ -0,0 +1,45 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_PARALLELBFSSOLVER_H
+#define KATOMIC_PARALLELBFSSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Breadth-first search like BfsSolver, run by SolverOptions::threadCount threads.
+ *
+ * The search goes one depth at a time. Threads take slices of the positions
+ * at the current depth, expand them and add new positions to a shared
+ * ConcurrentStateTable, collecting the numbers of those they added in buffers
+ * of their own. The buffers are joined into the next depth's positions when
+ * all threads are done. Solutions have the minimum number of moves, but
+ * which one of them is found may differ between runs.
+ */
+class ParallelBfsSolver : public Solver
+{
+public:
+    explicit ParallelBfsSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+    bool isParallel() const Q_DECL_OVERRIDE { return true; }
+};
+
+#endif
@@ -0,0 +1,242 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "parallelidasolver.h"
+
+#include <QList>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QScopedPointer>
+#include <QThread>
+#include <QThreadPool>
+#include <QtConcurrentRun>
+
+#include <atomic>
+#include <vector>
+
+#include "idastarsearch.h"
+
+namespace
+{
+
+/**
+ * Tasks of one thread, as indices into the iteration's task list
+ */
+struct TaskQueue
+{
+    QMutex mutex;
+    QList<int> tasks;
+};
+
+template<class Board>
+class ParallelIterativeDeepening
+{
+public:
+    typedef IdaStarSearch<Board> Search;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        ParallelIterativeDeepening search(level, options);
+        return search.solve();
+    }
+
+private:
+    ParallelIterativeDeepening(const LevelData* level, const SolverOptions& options)
+        : m_threadCount(options.threadCount > 0 ? options.threadCount : qMax(1, QThread::idealThreadCount())),
+        m_maxDepth(options.maxDepth), m_table(options.transpositionTableSize ? new TranspositionTable(options.transpositionTableSize) : 0),
+        m_queues(m_threadCount), m_found(false)
+    {
+        // thread 0 is the calling one, the pool runs the others
+        m_pool.setMaxThreadCount(qMax(1, m_threadCount - 1));
+        PatternDatabaseBound* patterns = Search::createPatternBound(level, options);
+        m_splitter = new Search(level, options, patterns);
+        for (int t = 0; t < m_threadCount; ++t)
+        {
+            Search* search = new Search(level, options, patterns);
+            search->setTranspositionTable(m_table.data());
+            search->setStopFlag(&m_stop);
+            m_searches.push_back(search);
+        }
+        delete patterns;
+    }
+    ~ParallelIterativeDeepening()
+    {
+        delete m_splitter;
+        qDeleteAll(m_searches);
+    }
+
+    // tasks wanted per thread, so that threads with slow tasks can be helped
+    enum { TasksPerThread = 32 };
+
+    SolverResult solve()
+    {
+        SolverResult result;
+        result.status = SolverResult::Unsolvable;
+        const int start = m_splitter->startEstimate();
+        if (start >= AssignmentBound::Infinite)
+            return result;
+
+        m_stop = false;
+        for (m_bound = start; ; )
+        {
+            if (m_splitter->isPastLongestPath(m_bound))
+                break;
+            if (m_maxDepth && m_bound > m_maxDepth)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            if (split())
+            {
+                result.status = SolverResult::Solved;
+                m_solution = m_splitter->path();
+                break;
+            }
+            if (m_splitter->isAborted())
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+
+            for (int i = 0; i < m_tasks.count(); ++i)
+                m_queues[i % m_threadCount].tasks.append(i);
+            for (int t = 1; t < m_threadCount; ++t)
+                QtConcurrent::run(&m_pool, this, &ParallelIterativeDeepening::work, t);
+            work(0);
+            m_pool.waitForDone();
+
+            if (m_found)
+            {
+                result.status = SolverResult::Solved;
+                break;
+            }
+            if (m_stop)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+
+            int nextBound = m_splitter->nextBound();
+            foreach (Search* search, m_searches)
+                nextBound = qMin(nextBound, search->nextBound());
+            if (nextBound == Search::Infinite)
+                break;
+            m_bound = nextBound;
+        }
+
+        result.moves = m_solution;
+        result.expandedStates = m_splitter->expandedStates();
+        foreach (Search* search, m_searches)
+            result.expandedStates += search->expandedStates();
+        result.storedStates = result.moves.count();
+        return result;
+    }
+
+    /**
+     *  Fills m_tasks for the iteration with bound m_bound, going deeper until
+     *  there are enough of them or the bound is reached.
+     *  @return true if the splitting search found a solution
+     */
+    bool split()
+    {
+        for (int depth = 1; ; ++depth)
+        {
+            m_tasks.clear();
+            m_splitter->setBound(m_bound);
+            if (m_splitter->search(QVector<SolverMove>(), &m_tasks, depth))
+                return true;
+            if (m_tasks.count() >= m_threadCount * TasksPerThread || depth >= m_bound
+                || m_tasks.isEmpty() || m_splitter->isAborted())
+                return false;
+        }
+    }
+
+    /**
+     *  Body of thread number thread: searches tasks until there are none left
+     */
+    void work(int thread)
+    {
+        Search* search = m_searches[thread];
+        search->setBound(m_bound);
+        int task;
+        while (!m_stop.load(std::memory_order_relaxed) && takeTask(thread, &task))
+        {
+            if (search->search(m_tasks.at(task)))
+            {
+                QMutexLocker lock(&m_solutionMutex);
+                if (!m_found)
+                {
+                    m_found = true;
+                    m_solution = search->path();
+                }
+                m_stop = true;
+            }
+            else if (search->isAborted())
+                m_stop = true;
+        }
+    }
+
+    bool takeTask(int thread, int* task)
+    {
+        {
+            TaskQueue& own = m_queues[thread];
+            QMutexLocker lock(&own.mutex);
+            if (!own.tasks.isEmpty())
+            {
+                *task = own.tasks.takeLast();
+                return true;
+            }
+        }
+        for (int i = 1; i < m_threadCount; ++i)
+        {
+            TaskQueue& victim = m_queues[(thread + i) % m_threadCount];
+            QMutexLocker lock(&victim.mutex);
+            if (!victim.tasks.isEmpty())
+            {
+                *task = victim.tasks.takeFirst();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    const int m_threadCount;
+    QThreadPool m_pool;
+    const int m_maxDepth;
+    QScopedPointer<TranspositionTable> m_table;
+    // searches down to the tasks, and one search per thread below them
+    Search* m_splitter;
+    std::vector<Search*> m_searches;
+    QVector<QVector<SolverMove> > m_tasks;
+    std::vector<TaskQueue> m_queues;
+    int m_bound;
+    std::atomic<bool> m_stop;
+    QMutex m_solutionMutex;
+    bool m_found;
+    QVector<SolverMove> m_solution;
+};
+
+}
+
+SolverResult ParallelIdaSolver::solve(const LevelData* level)
+{
+    return searchOnBoard<ParallelIterativeDeepening>(level);
+}
@@ -0,0 +1,49 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_PARALLELIDASOLVER_H
+#define KATOMIC_PARALLELIDASOLVER_H
+
+#include "solver.h"
+
+/**
+ * IDA* like IdaSolver, run by SolverOptions::threadCount threads.
+ *
+ * Each iteration is split into tasks: the positions a few moves below the
+ * start, deep enough to give every thread plenty of them. The tasks are
+ * dealt out to per-thread queues. Threads take tasks from the back of their
+ * own queue and, when it runs empty, steal from the front of the others.
+ *
+ * A TranspositionTable shared by all threads skips positions some thread
+ * has reached in as few moves in the same iteration, so transpositions
+ * aren't searched once per task. That never skips the only way to a shorter
+ * solution, and iterations still end only when all their tasks are done, so
+ * solutions are as short as IdaSolver's.
+ */
+class ParallelIdaSolver : public Solver
+{
+public:
+    explicit ParallelIdaSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+    bool isParallel() const Q_DECL_OVERRIDE { return true; }
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "patterndatabase.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <string.h>
+#include <vector>
+
+// file layout: magic, format version, free cell count, atom count, then the table
+static const char PdbMagic[8] = { 'K', 'A', 'T', 'O', 'M', 'P', 'D', 'B' };
+static const quint32 PdbVersion = 1;
+static const int PdbHeaderSize = 8 + 3*4;
+
+// largest subset a table is built for
+static const int MaxPatternAtoms = 3;
+
+PatternDatabase::PatternDatabase(const LevelData* level, const QVector<int>& atoms, const QString& cacheDir)
+    : m_atoms(atoms), m_freeCount(0), m_data(0)
+{
+    const int stride = level->stride();
+    m_freeIndex.fill(-1, level->cellCount());
+    for (int y = 0; y < level->height(); ++y)
+        for (int x = 0; x < level->width(); ++x)
+            if (!level->containsWallAt(x, y))
+            {
+                m_freeIndex[y*stride + x] = m_freeCount++;
+                m_freeCells.append(y*stride + x);
+            }
+    m_size = tableSize(level, m_atoms.count());
+
+    QString fileName;
+    if (!cacheDir.isEmpty())
+    {
+        fileName = cacheDir + QLatin1Char('/') + QString::fromLatin1(cacheKey(level)) + QStringLiteral(".pdb");
+        if (load(fileName))
+            return;
+    }
+
+    build(level);
+    if (!fileName.isEmpty())
+        save(fileName);
+}
+
+quint64 PatternDatabase::tableSize(const LevelData* level, int atomCount)
+{
+    quint64 freeCount = 0;
+    for (int y = 0; y < level->height(); ++y)
+        for (int x = 0; x < level->width(); ++x)
+            if (!level->containsWallAt(x, y))
+                freeCount++;
+
+    quint64 size = 1;
+    for (int i = 0; i < atomCount; ++i)
+        size *= freeCount;
+    return size;
+}
+
+QByteArray PatternDatabase::cacheKey(const LevelData* level) const
+{
+    // everything the table depends on: walls, molecule and the kinds of the atoms
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << PdbVersion << level->width() << level->height();
+    for (int y = 0; y < level->height(); ++y)
+        for (int x = 0; x < level->width(); ++x)
+            stream << level->containsWallAt(x, y);
+    foreach (const LevelData::Element& el, level->moleculeAtoms())
+        stream << el.atom << el.x << el.y;
+    const QList<LevelData::Element> levelAtoms = level->atomElements();
+    foreach (int atom, m_atoms)
+        stream << levelAtoms.at(atom).atom;
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+}
+
+bool PatternDatabase::load(const QString& fileName)
+{
+    m_file.setFileName(fileName);
+    if (!m_file.open(QIODevice::ReadOnly))
+        return false;
+
+    const QByteArray header = m_file.read(PdbHeaderSize);
+    QDataStream stream(header.mid(8));
+    quint32 version, freeCount, atomCount;
+    stream >> version >> freeCount >> atomCount;
+    if (header.size() != PdbHeaderSize || memcmp(header.constData(), PdbMagic, 8) != 0
+        || version != PdbVersion || int(freeCount) != m_freeCount || int(atomCount) != m_atoms.count()
+        || quint64(m_file.size()) != PdbHeaderSize + m_size)
+    {
+        qDebug() << "ignoring invalid pattern database" << fileName;
+        m_file.close();
+        return false;
+    }
+
+    m_data = m_file.map(PdbHeaderSize, m_size);
+    if (!m_data)
+    {
+        m_file.close();
+        return false;
+    }
+    return true;
+}
+
+void PatternDatabase::save(const QString& fileName) const
+{
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return;
+
+    QByteArray header(PdbMagic, 8);
+    QDataStream stream(&header, QIODevice::Append);
+    stream << PdbVersion << quint32(m_freeCount) << quint32(m_atoms.count());
+    file.write(header);
+    file.write(m_table);
+    if (!file.commit())
+        qDebug() << "failed to save pattern database" << fileName;
+}
+
+void PatternDatabase::build(const LevelData* level)
+{
+    const int count = m_atoms.count();
+    const int stride = level->stride();
+    m_table.fill(char(Unreachable), m_size);
+    uchar* dist = reinterpret_cast<uchar*>(m_table.data());
+    m_data = dist;
+
+    std::vector<quint32> queue;
+
+    // goal placements: every anchor, with identical atoms of the subset in any order
+    const QList<LevelData::Element> levelAtoms = level->atomElements();
+    const QList<LevelData::Element>& molAtoms = level->moleculeAtoms();
+    for (int k = 0; k < level->goalAnchorCount(); ++k)
+    {
+        // choice[i] is the molecule atom subset atom i is placed on
+        int choice[MaxPatternAtoms];
+        int i = 0;
+        choice[0] = -1;
+        while (i >= 0)
+        {
+            // next molecule atom of the right kind that isn't taken yet
+            int c = choice[i] + 1;
+            for (; c < molAtoms.count(); ++c)
+            {
+                bool taken = molAtoms.at(c).atom != levelAtoms.at(m_atoms.at(i)).atom;
+                for (int j = 0; j < i && !taken; ++j)
+                    taken = choice[j] == c;
+                if (!taken)
+                    break;
+            }
+            if (c == molAtoms.count())
+            {
+                i--;
+                continue;
+            }
+            choice[i] = c;
+            if (i + 1 < count)
+            {
+                choice[++i] = -1;
+                continue;
+            }
+
+            quint64 idx = 0;
+            for (int j = 0; j < count; ++j)
+            {
+                const LevelData::Element& el = molAtoms.at(choice[j]);
+                idx = idx * m_freeCount + m_freeIndex.at(level->goalAnchorCell(k) + el.y*stride + el.x);
+            }
+            if (dist[idx] != 0)
+            {
+                dist[idx] = 0;
+                queue.push_back(idx);
+            }
+        }
+    }
+
+    for (size_t head = 0; head < queue.size(); ++head)
+    {
+        const quint64 idx = queue[head];
+        // distances too long for a byte are cut, which keeps them lower bounds
+        const int next = qMin(dist[idx] + 1, Unreachable - 1);
+
+        int cells[MaxPatternAtoms];
+        quint64 digits[MaxPatternAtoms];
+        quint64 rest = idx;
+        for (int j = count - 1; j >= 0; --j)
+        {
+            digits[j] = rest % m_freeCount;
+            cells[j] = m_freeCells.at(digits[j]);
+            rest /= m_freeCount;
+        }
+
+        quint64 weight = 1;
+        for (int j = count - 1; j >= 0; weight *= m_freeCount, --j)
+        {
+            const int x = cells[j] % stride;
+            const int y = cells[j] / stride;
+            for (int dir = 0; dir < 4; ++dir)
+            {
+                const int dx = KAtomic::stepX(static_cast<KAtomic::Direction>(dir));
+                const int dy = KAtomic::stepY(static_cast<KAtomic::Direction>(dir));
+                for (int step = 1; ; ++step)
+                {
+                    const int nx = x + step*dx;
+                    const int ny = y + step*dy;
+                    if (level->containsWallAt(nx, ny))
+                        break;
+                    const int cell = ny*stride + nx;
+                    bool occupied = false;
+                    for (int o = 0; o < count && !occupied; ++o)
+                        occupied = cells[o] == cell;
+                    if (occupied)
+                        break;
+
+                    const quint64 nidx = idx + (quint64(m_freeIndex.at(cell)) - digits[j]) * weight;
+                    if (dist[nidx] == Unreachable)
+                    {
+                        dist[nidx] = next;
+                        queue.push_back(nidx);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// ==================================================
+
+PatternDatabaseBound::PatternDatabaseBound(const LevelData* level, const QString& cacheDir, quint64 maxTableSize)
+    : m_sum(0), m_unreachable(0)
+{
+    int groupSize = MaxPatternAtoms;
+    while (groupSize > 0 && PatternDatabase::tableSize(level, groupSize) > maxTableSize)
+        groupSize--;
+    if (groupSize == 0)
+        return;
+
+    // atoms of a kind next to each other, so that identical atoms share tables
+    const QList<LevelData::Element> atoms = level->atomElements();
+    QVector<int> order;
+    for (int i = 0; i < atoms.count(); ++i)
+    {
+        int pos = order.count();
+        for (int j = 0; j < order.count(); ++j)
+            if (atoms.at(order.at(j)).atom == atoms.at(i).atom)
+                pos = j + 1;
+        order.insert(pos, i);
+    }
+
+    m_atomDatabases.resize(atoms.count());
+    for (int first = 0; first < order.count(); first += groupSize)
+    {
+        const QVector<int> group = order.mid(first, groupSize);
+        foreach (int atom, group)
+            m_atomDatabases[atom] = m_databases.count();
+        m_databases.append(QSharedPointer<const PatternDatabase>(new PatternDatabase(level, group, cacheDir)));
+    }
+    m_values.fill(0, m_databases.count());
+}
@@ -0,0 +1,165 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_PATTERNDATABASE_H
+#define KATOMIC_PATTERNDATABASE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QList>
+#include <QSharedPointer>
+#include <QString>
+#include <QVector>
+
+#include "levelset.h"
+
+/**
+ * Exact distance to the goal of a subset of a level's atoms, for every
+ * placement of them, with all other atoms taken off the field.
+ *
+ * As the missing atoms could stop a sliding atom anywhere on its way, a move
+ * of the subset takes an atom to any cell of a straight run free of walls
+ * and subset atoms. That makes every real move a subset move (or no move for
+ * the subset at all), so the table never overestimates. The goal is the
+ * subset's atoms at their molecule places around any feasible anchor.
+ *
+ * Tables are built by a breadth-first search from all goal placements and
+ * take freeCells^atoms bytes. When given a cache directory they are saved
+ * there, keyed by the level layout, and memory-mapped when needed again.
+ */
+class PatternDatabase
+{
+public:
+    enum { Unreachable = 0xff };
+
+    /**
+     *  Loads or builds the table for the given atoms (indices within
+     *  LevelData::atomElements()). cacheDir may be empty to not use files
+     */
+    PatternDatabase(const LevelData* level, const QVector<int>& atoms, const QString& cacheDir);
+
+    const QVector<int>& atoms() const { return m_atoms; }
+    /**
+     *  Number of table entries for this many atoms of level
+     */
+    static quint64 tableSize(const LevelData* level, int atomCount);
+
+    /**
+     *  Moves the subset needs from the placement of its atoms in cells
+     *  (cells[i] is the cell of level atom i), or Unreachable
+     */
+    template<typename Cell>
+    int value(const Cell* cells) const
+    {
+        quint64 idx = 0;
+        for (int i = 0; i < m_atoms.count(); ++i)
+            idx = idx * m_freeCount + m_freeIndex.at(cells[m_atoms.at(i)]);
+        return m_data[idx];
+    }
+
+private:
+    QByteArray cacheKey(const LevelData* level) const;
+    bool load(const QString& fileName);
+    void build(const LevelData* level);
+    void save(const QString& fileName) const;
+
+    QVector<int> m_atoms;
+    // position of each cell among the free ones, -1 for walls
+    QVector<int> m_freeIndex;
+    QVector<int> m_freeCells;
+    int m_freeCount;
+    quint64 m_size;
+
+    // entries are in m_table when built here, or in the mapped m_file
+    QByteArray m_table;
+    QFile m_file;
+    const uchar* m_data;
+};
+
+/**
+ * Additive lower bound from pattern databases of disjoint atom subsets.
+ *
+ * A move moves one atom, so it is counted by one table only and the tables'
+ * values add up. Atoms of a kind are kept together and the subsets are as
+ * large as the table size limit allows.
+ *
+ * Copies share the tables, so searches in several threads can each have
+ * their own bound without building the tables again.
+ */
+class PatternDatabaseBound
+{
+public:
+    enum { Infinite = 0x3fffffff };
+
+    /**
+     *  @param maxTableSize limit of entries of one table. Nothing is built
+     *  (isUsable() is false) if even single atom tables would be too large
+     */
+    PatternDatabaseBound(const LevelData* level, const QString& cacheDir, quint64 maxTableSize);
+
+    bool isUsable() const { return !m_databases.isEmpty(); }
+
+    template<typename Cell>
+    void reset(const Cell* cells)
+    {
+        m_sum = 0;
+        m_unreachable = 0;
+        for (int i = 0; i < m_databases.count(); ++i)
+        {
+            m_values[i] = 0;
+            updateDatabase(i, m_databases.at(i)->value(cells));
+        }
+    }
+    /**
+     *  Updates the bound after atom idx has moved, or its move was undone
+     */
+    template<typename Cell>
+    void atomMoved(int idx, const Cell* cells)
+    {
+        const int db = m_atomDatabases.at(idx);
+        updateDatabase(db, m_databases.at(db)->value(cells));
+    }
+
+    int value() const { return m_unreachable ? int(Infinite) : m_sum; }
+
+private:
+    void updateDatabase(int db, int value)
+    {
+        const int old = m_values.at(db);
+        if (old == PatternDatabase::Unreachable)
+            m_unreachable--;
+        else
+            m_sum -= old;
+        if (value == PatternDatabase::Unreachable)
+            m_unreachable++;
+        else
+            m_sum += value;
+        m_values[db] = value;
+    }
+
+    QList<QSharedPointer<const PatternDatabase> > m_databases;
+    // database of each atom of the level
+    QVector<int> m_atomDatabases;
+    QVector<int> m_values;
+    int m_sum;
+    int m_unreachable;
+};
+
+#endif
@@ -30,6 +30,7 @@
 
 
 #include <KConfig>
+#include <KLocalizedString>
 #include <QDebug>
 #include <kconfiggroup.h>
 
@@ -40,6 +41,7 @@
 #include "molecule.h"
 #include "fielditem.h"
 #include "levelset.h"
+#include "tablebase.h"
 
 struct Theme : public KgTheme
 {
@@ -50,8 +52,8 @@ struct Theme : public KgTheme
 };
 
 PlayField::PlayField( QObject* parent )
-    : QGraphicsScene(parent), m_renderer(new Theme), m_numMoves(0), m_levelData(0),
-    m_elemSize(MIN_ELEM_SIZE), m_selIdx(-1), m_animSpeed(120),
+    : QGraphicsScene(parent), m_renderer(new Theme), m_numMoves(0), m_levelData(0), m_board(0), m_tablebase(0),
+    m_tablebaseOpened(false), m_elemSize(MIN_ELEM_SIZE), m_selIdx(-1), m_animSpeed(120),
     m_levelFinished(false)
 {
     m_atomTimeLine = new QTimeLine(300, this);
@@ -79,6 +81,8 @@ PlayField::~PlayField()
     //bug(?) in KGameRenderer's deletion code
     qDeleteAll(m_atoms);
     m_atoms.clear();
+    delete m_board;
+    delete m_tablebase;
 }
 
 void PlayField::setLevelData(const LevelData* level)
@@ -95,6 +99,16 @@ void PlayField::setLevelData(const LevelData* level)
     m_levelFinished = false;
     m_atomTimeLine->stop();
     m_levelData = level;
+    delete m_board;
+    m_board = BoardState::create(level);
+    delete m_tablebase;
+    m_tablebase = 0;
+    m_tablebaseFileName.clear();
+    m_tablebaseOpened = false;
+
+    // element size depends on the field size, which may differ from the previous level
+    if (!sceneRect().isEmpty())
+        resize(sceneRect().width(), sceneRect().height());
 
     m_undoStack.clear();
     m_redoStack.clear();
@@ -111,6 +125,8 @@ void PlayField::setLevelData(const LevelData* level)
         m_atoms.append(atom);
     }
 
+    updateAtomGrid();
+
     m_selIdx = -1;
     updateArrows(true); // this will hide them (no atom selected)
     updateFieldItems();
@@ -119,6 +135,78 @@ void PlayField::setLevelData(const LevelData* level)
     update();
 }
 
+void PlayField::setTablebaseFileName(const QString& fileName)
+{
+    delete m_tablebase;
+    m_tablebase = 0;
+    m_tablebaseFileName = fileName;
+    m_tablebaseOpened = false;
+}
+
+Tablebase* PlayField::tablebase()
+{
+    if (!m_tablebaseOpened && m_levelData)
+    {
+        m_tablebase = Tablebase::open(m_levelData, m_tablebaseFileName);
+        m_tablebaseOpened = true;
+    }
+    return m_tablebase;
+}
+
+int PlayField::optimalMovesLeft()
+{
+    return tablebase() ? m_tablebase->distance(m_board) : -1;
+}
+
+bool PlayField::bestNextMove(int* atom, Direction* dir)
+{
+    KAtomic::Direction boardDir;
+    if (!tablebase() || !m_tablebase->bestMove(m_board, atom, &boardDir))
+        return false;
+    *dir = static_cast<Direction>(boardDir);
+    return true;
+}
+
+void PlayField::showHint()
+{
+    if (isAnimating() || m_levelFinished || !m_levelData)
+        return;
+
+    int atom;
+    Direction dir;
+    if (!bestNextMove(&atom, &dir))
+    {
+        if (tablebase())
+            showMessage(i18n("The molecule can't be made from here, undo some moves."));
+        else
+            showMessage(i18n("There are no hints for this level."));
+        return;
+    }
+
+    m_selIdx = atom;
+    updateArrows();
+    const int movesLeft = optimalMovesLeft();
+    switch (dir)
+    {
+        case Up:
+            showMessage(i18np("Move the selected atom up. The molecule can be made in 1 move.",
+                              "Move the selected atom up. The molecule can be made in %1 moves.", movesLeft));
+            break;
+        case Down:
+            showMessage(i18np("Move the selected atom down. The molecule can be made in 1 move.",
+                              "Move the selected atom down. The molecule can be made in %1 moves.", movesLeft));
+            break;
+        case Left:
+            showMessage(i18np("Move the selected atom left. The molecule can be made in 1 move.",
+                              "Move the selected atom left. The molecule can be made in %1 moves.", movesLeft));
+            break;
+        case Right:
+            showMessage(i18np("Move the selected atom right. The molecule can be made in 1 move.",
+                              "Move the selected atom right. The molecule can be made in %1 moves.", movesLeft));
+            break;
+    }
+}
+
 void PlayField::updateFieldItems()
 {
     if (!m_levelData || !m_levelData->molecule())
@@ -170,7 +258,7 @@ void PlayField::resize( int width, int height)
     width -= previewWidth;
 
     int oldSize = m_elemSize;
-    m_elemSize = qMin(width, height) / FIELD_SIZE;
+    m_elemSize = qMax(1, qMin(width / fieldWidth(), height / fieldHeight()));
     m_previewItem->setMaxAtomSize( m_elemSize );
 
     // if atom animation is running we need to rescale timeline
@@ -202,34 +290,25 @@ void PlayField::nextAtom()
         return;
     }
 
-    int xs = m_atoms.at(m_selIdx)->fieldX();
-    int ys = m_atoms.at(m_selIdx)->fieldY()+1;
+    // walk the field column by column starting right below the selected atom
+    int x = m_board->atomX(m_selIdx);
+    int y = m_board->atomY(m_selIdx);
 
-    int x = xs;
-
-    while(1)
+    const int fw = fieldWidth();
+    const int fh = fieldHeight();
+    for( int i=0; i<fw*fh; ++i )
     {
-        for(int y=ys; y<FIELD_SIZE; ++y )
+        if( ++y == fh )
         {
-            int px = toPixX(x)+m_elemSize/2;
-            int py = toPixY(y)+m_elemSize/2;
-            const QList<QGraphicsItem *> itemsAtPoint = items(QPointF(px, py));
-            if( !itemsAtPoint.isEmpty() )
-            {
-                AtomFieldItem* item = qgraphicsitem_cast<AtomFieldItem*>( itemsAtPoint[0] );
-                m_selIdx = m_atoms.indexOf(item);
-                updateArrows();
-                // if this atom can't move, we won't return - we'll search further
-                // until we found moveable one
-                if( m_upArrow->isVisible() || m_rightArrow->isVisible()
-                        || m_downArrow->isVisible() || m_leftArrow->isVisible() )
-                    return;
-            }
+            y = 0;
+            if( ++x == fw )
+                x = 0;
         }
-        x++;
-        if(x==FIELD_SIZE)
-            x = 0;
-        ys=0;
+        int idx = atomIndexAt(x, y);
+        // if this atom can't move, we won't return - we'll search further
+        // until we found moveable one
+        if( idx != -1 && selectAtom(idx) )
+            return;
     }
 }
 
@@ -245,40 +324,36 @@ void PlayField::previousAtom()
         return;
     }
 
-    int xs = m_atoms.at(m_selIdx)->fieldX();
-    int ys = m_atoms.at(m_selIdx)->fieldY()-1;
-
-    int x = xs;
+    // walk the field column by column starting right above the selected atom
+    int x = m_board->atomX(m_selIdx);
+    int y = m_board->atomY(m_selIdx);
 
-    while(1)
+    const int fw = fieldWidth();
+    const int fh = fieldHeight();
+    for( int i=0; i<fw*fh; ++i )
     {
-        for(int y=ys; y>=0; --y )
+        if( --y < 0 )
         {
-            int px = toPixX(x)+m_elemSize/2;
-            int py = toPixY(y)+m_elemSize/2;
-            const QList<QGraphicsItem *> itemsAtPoint = items(QPointF(px, py));
-            if( !itemsAtPoint.isEmpty() )
-            {
-                AtomFieldItem* item = qgraphicsitem_cast<AtomFieldItem*>( itemsAtPoint[0] );
-                if ( item && item->atomNum() != -1 )
-                {
-                    m_selIdx = m_atoms.indexOf(item);
-                    updateArrows();
-                    // if this atom can't move, we won't return - we'll search further
-                    // until we found moveable one
-                    if( m_upArrow->isVisible() || m_rightArrow->isVisible()
-                            || m_downArrow->isVisible() || m_leftArrow->isVisible() )
-                        return;
-                }
-            }
+            y = fh-1;
+            if( --x < 0 )
+                x = fw-1;
         }
-        x--;
-        if(x==0)
-            x = FIELD_SIZE-1;
-        ys=FIELD_SIZE-1;
+        int idx = atomIndexAt(x, y);
+        // if this atom can't move, we won't return - we'll search further
+        // until we found moveable one
+        if( idx != -1 && selectAtom(idx) )
+            return;
     }
 }
 
+bool PlayField::selectAtom(int idx)
+{
+    m_selIdx = idx;
+    updateArrows();
+    return m_upArrow->isVisible() || m_rightArrow->isVisible()
+        || m_downArrow->isVisible() || m_leftArrow->isVisible();
+}
+
 void PlayField::undo()
 {
     if( isAnimating() || m_undoStack.isEmpty())
@@ -344,28 +419,16 @@ void PlayField::undoAll()
         m_redoStack.push( am );
 
         // adjust atom pos
-        AtomFieldItem *atom = m_atoms.at(am.atomIdx);
-        int xdelta = 0, ydelta = 0;
-        switch(am.dir)
-        {
-            case Up:
-                ydelta = am.numCells;
-                break;
-            case Down:
-                ydelta = -am.numCells;
-                break;
-            case Right:
-                xdelta = -am.numCells;
-                break;
-            case Left:
-                xdelta = am.numCells;
-                break;
-        }
-        atom->setFieldXY( atom->fieldX()+xdelta, atom->fieldY()+ydelta );
+        m_board->undoMove( am.atomIdx, static_cast<BoardState::Direction>(am.dir), am.numCells );
     }
-    // update pixel positions
-    foreach( AtomFieldItem* atom, m_atoms )
+    updateAtomGrid();
+    // update field and pixel positions
+    for( int idx=0; idx<m_atoms.count(); ++idx )
+    {
+        AtomFieldItem *atom = m_atoms.at(idx);
+        atom->setFieldXY( m_board->atomX(idx), m_board->atomY(idx) );
         atom->setPos( toPixX(atom->fieldX()), toPixY(atom->fieldY()));
+    }
 
     m_numMoves = 0;
     emit updateMoves(m_numMoves);
@@ -383,28 +446,16 @@ void PlayField::redoAll()
         m_undoStack.push( am );
 
         // adjust atom pos
-        AtomFieldItem *atom = m_atoms.at(am.atomIdx);
-        int xdelta = 0, ydelta = 0;
-        switch(am.dir)
-        {
-            case Up:
-                ydelta = -am.numCells;
-                break;
-            case Down:
-                ydelta = am.numCells;
-                break;
-            case Right:
-                xdelta = am.numCells;
-                break;
-            case Left:
-                xdelta = -am.numCells;
-                break;
-        }
-        atom->setFieldXY( atom->fieldX()+xdelta, atom->fieldY()+ydelta );
+        m_board->moveAtom( am.atomIdx, static_cast<BoardState::Direction>(am.dir), am.numCells );
     }
-    // update pixel positions
-    foreach( AtomFieldItem * atom, m_atoms )
+    updateAtomGrid();
+    // update field and pixel positions
+    for( int idx=0; idx<m_atoms.count(); ++idx )
+    {
+        AtomFieldItem *atom = m_atoms.at(idx);
+        atom->setFieldXY( m_board->atomX(idx), m_board->atomY(idx) );
         atom->setPos( toPixX(atom->fieldX()), toPixY(atom->fieldY()));
+    }
 
     m_numMoves = m_undoStack.count();
     emit updateMoves(m_numMoves);
@@ -421,32 +472,36 @@ void PlayField::mousePressEvent( QGraphicsSceneMouseEvent* ev )
     if( isAnimating() || m_levelFinished )
         return;
 
-    const QList<QGraphicsItem *> itemsAtPoint = items(ev->scenePos());
-    if(itemsAtPoint.isEmpty())
+    if( ev->scenePos().x() < 0 || ev->scenePos().y() < 0 )
         return;
 
-    AtomFieldItem *atomItem = qgraphicsitem_cast<AtomFieldItem*>(itemsAtPoint[0]);
-    if( atomItem ) // that is: atom selected
+    int x = toFieldX( (int)ev->scenePos().x() );
+    int y = toFieldY( (int)ev->scenePos().y() );
+    if( x >= fieldWidth() || y >= fieldHeight() )
+        return;
+
+    int atomIdx = atomIndexAt( x, y );
+    if( atomIdx != -1 ) // that is: atom selected
     {
-        m_selIdx = m_atoms.indexOf( atomItem );
+        m_selIdx = atomIdx;
         updateArrows();
         return;
     }
 
-    ArrowFieldItem *arrowItem = qgraphicsitem_cast<ArrowFieldItem*>(itemsAtPoint[0]);
-    if( arrowItem == m_upArrow )
+    // visible arrows always sit in the empty cells around selected atom
+    if( m_upArrow->isVisible() && m_upArrow->fieldX() == x && m_upArrow->fieldY() == y )
     {
         moveSelectedAtom( Up );
     }
-    else if( arrowItem == m_downArrow )
+    else if( m_downArrow->isVisible() && m_downArrow->fieldX() == x && m_downArrow->fieldY() == y )
     {
         moveSelectedAtom( Down );
     }
-    else if( arrowItem == m_rightArrow )
+    else if( m_rightArrow->isVisible() && m_rightArrow->fieldX() == x && m_rightArrow->fieldY() == y )
     {
         moveSelectedAtom( Right );
     }
-    else if( arrowItem == m_leftArrow )
+    else if( m_leftArrow->isVisible() && m_leftArrow->fieldX() == x && m_leftArrow->fieldY() == y )
     {
         moveSelectedAtom( Left );
     }
@@ -465,33 +520,7 @@ void PlayField::moveSelectedAtom( Direction dir, int numCells )
     // function was called interactively (=0) or from  undo/redo functions(!=0)
     if(numCells == 0) // then we'll calculate
     {
-        // helpers
-        int x = 0, y = 0;
-        int selX = m_atoms.at(m_selIdx)->fieldX();
-        int selY = m_atoms.at(m_selIdx)->fieldY();
-        switch( dir )
-        {
-            case Up:
-                y = selY;
-                while( cellIsEmpty(selX, --y) )
-                    numEmptyCells++;
-                break;
-            case Down:
-                y = selY;
-                while( cellIsEmpty(selX, ++y) )
-                    numEmptyCells++;
-                break;
-            case Left:
-                x = selX;
-                while( cellIsEmpty(--x, selY) )
-                    numEmptyCells++;
-                break;
-            case Right:
-                x = selX;
-                while( cellIsEmpty(++x, selY) )
-                    numEmptyCells++;
-                break;
-        }
+        numEmptyCells = m_board->slideDistance( m_selIdx, static_cast<BoardState::Direction>(dir) );
         // and clear the redo stack. we do it here
         // because if this function is called with numCells=0
         // this indicates it is called not from undo()/redo(),
@@ -553,8 +582,11 @@ void PlayField::atomAnimFrameChanged(int frame)
     {
         // NOTE: consider moving this to separate function (something like moveFinished())
         // to improve code readablility
-        selAtom->setFieldX( toFieldX((int)selAtom->pos().x()) );
-        selAtom->setFieldY( toFieldY((int)selAtom->pos().y()) );
+        int numCells = m_atomTimeLine->endFrame()/m_elemSize;
+        m_atomGrid.remove(selAtom->fieldY()*fieldWidth() + selAtom->fieldX());
+        m_board->moveAtom( m_selIdx, static_cast<BoardState::Direction>(m_dir), numCells );
+        selAtom->setFieldXY( m_board->atomX(m_selIdx), m_board->atomY(m_selIdx) );
+        m_atomGrid.insert(selAtom->fieldY()*fieldWidth() + selAtom->fieldX(), m_selIdx);
         updateArrows();
 
         emit updateMoves(m_numMoves);
@@ -570,7 +602,6 @@ void PlayField::atomAnimFrameChanged(int frame)
     }
 }
 
-// most complicated algorithm ;-)
 bool PlayField::checkDone() const
 {
     if (!m_levelData || !m_levelData->molecule())
@@ -578,51 +609,25 @@ bool PlayField::checkDone() const
         //qDebug() << "level or molecule data is null!";
         return false;
     }
-    // let's assume that molecule is done
-    // and see if we can break assumtion
-    //
-    // first we find molecule origin in field coords
-    // by finding minimum fieldX, fieldY through all atoms
-    int minX = FIELD_SIZE+1;
-    int minY = FIELD_SIZE+1;
-    foreach( AtomFieldItem* atom, m_atoms )
-    {
-        if(atom->fieldX() < minX)
-            minX = atom->fieldX();
-        if(atom->fieldY() < minY)
-            minY = atom->fieldY();
-    }
-    // so origin is (minX,minY)
-    // we'll subtract this origin from each atom's coords and check
-    // if the resulting position is the same as this atom has in molecule
-    foreach( AtomFieldItem* atom, m_atoms )
-    {
-        uint atomNum = atom->atomNum();
-        int molecCoordX = atom->fieldX() - minX;
-        int molecCoordY = atom->fieldY() - minY;
-        if( m_levelData->molecule()->getAtom( molecCoordX, molecCoordY ) != atomNum )
-            return false; // nope. not there
-    }
-    return true;
+    return m_board->isSolved();
 }
 
-bool PlayField::cellIsEmpty(int x, int y) const
+int PlayField::atomIndexAt(int x, int y) const
 {
-    if (!m_levelData)
-    {
-        //qDebug() << "level data is null!";
-        return true;
-    }
+    if (x < 0 || y < 0 || x >= fieldWidth() || y >= fieldHeight())
+        return -1;
 
-    if(m_levelData->containsWallAt(x,y))
-        return false; // it is a wall
+    return m_atomGrid.value(y*fieldWidth() + x, -1);
+}
 
-    foreach( AtomFieldItem *atom, m_atoms )
-    {
-        if( atom->fieldX() == x && atom->fieldY() == y )
-            return false;
-    }
-    return true;
+void PlayField::updateAtomGrid()
+{
+    m_atomGrid.clear();
+    if (!m_board)
+        return;
+
+    for (int idx = 0; idx < m_board->atomCount(); ++idx)
+        m_atomGrid.insert(m_board->atomY(idx)*fieldWidth() + m_board->atomX(idx), idx);
 }
 
 void PlayField::setAnimationSpeed(int speed)
@@ -648,25 +653,25 @@ void PlayField::updateArrows(bool justHide)
     int selX = m_atoms.at(m_selIdx)->fieldX();
     int selY = m_atoms.at(m_selIdx)->fieldY();
 
-    if(cellIsEmpty(selX-1, selY))
+    if(m_board->canMove(m_selIdx, KAtomic::Left))
     {
         m_leftArrow->show();
         m_leftArrow->setFieldXY( selX-1, selY );
         m_leftArrow->setPos( toPixX(selX-1), toPixY(selY) );
     }
-    if(cellIsEmpty(selX+1, selY))
+    if(m_board->canMove(m_selIdx, KAtomic::Right))
     {
         m_rightArrow->show();
         m_rightArrow->setFieldXY( selX+1, selY );
         m_rightArrow->setPos( toPixX(selX+1), toPixY(selY) );
     }
-    if(cellIsEmpty(selX, selY-1))
+    if(m_board->canMove(m_selIdx, KAtomic::Up))
     {
         m_upArrow->show();
         m_upArrow->setFieldXY( selX, selY-1 );
         m_upArrow->setPos( toPixX(selX), toPixY(selY-1) );
     }
-    if(cellIsEmpty(selX, selY+1))
+    if(m_board->canMove(m_selIdx, KAtomic::Down))
     {
         m_downArrow->show();
         m_downArrow->setFieldXY( selX, selY+1 );
@@ -674,7 +679,7 @@ void PlayField::updateArrows(bool justHide)
     }
 }
 
-void PlayField::drawForeground( QPainter *p, const QRectF&)
+void PlayField::drawForeground( QPainter *p, const QRectF& rect)
 {
     if (!m_levelData)
     {
@@ -683,8 +688,13 @@ void PlayField::drawForeground( QPainter *p, const QRectF&)
     }
 
     QPixmap aPix = m_renderer.spritePixmap(QStringLiteral("wall"), QSize(m_elemSize, m_elemSize));
-    for (int i = 0; i < FIELD_SIZE; i++)
-        for (int j = 0; j < FIELD_SIZE; j++)
+    // large fields have lots of cells, only go through the exposed ones
+    const int left = qMax(0, toFieldX(qMax(0, (int)rect.left())));
+    const int top = qMax(0, toFieldY(qMax(0, (int)rect.top())));
+    const int right = qMin(fieldWidth() - 1, toFieldX((int)rect.right()));
+    const int bottom = qMin(fieldHeight() - 1, toFieldY((int)rect.bottom()));
+    for (int i = left; i <= right; i++)
+        for (int j = top; j <= bottom; j++)
             if(m_levelData->containsWallAt(i,j))
                 p->drawPixmap(toPixX(i), toPixY(j), aPix);
 }
@@ -722,20 +732,44 @@ void PlayField::saveGame( KConfigGroup& config ) const
     }
     config.writeEntry("SelectedAtom", m_selIdx);
     config.writeEntry("LevelFinished", m_levelFinished );
+    // fingerprint of the atom placement, to check it on loading
+    config.writeEntry("PositionHash", QString::number(positionHash(), 16));
 }
 
-void PlayField::loadGame( const KConfigGroup& config )
+bool PlayField::loadGame( const KConfigGroup& config )
 {
     // it is assumed that this method is called right after setLevelData() so
     // level itself is already loaded at this point
 
     // read atom positions
+    QVector<QPoint> positions(m_atoms.count());
+    QVector<int> cells(m_atoms.count());
+    QVector<int> startCells(m_atoms.count());
     for(int idx=0; idx<m_atoms.count(); ++idx)
     {
-        QPoint pos = config.readEntry( QStringLiteral("Atom_%1").arg(idx), QPoint() );
+        positions[idx] = config.readEntry( QStringLiteral("Atom_%1").arg(idx), QPoint() );
+        cells[idx] = positions[idx].y()*m_levelData->stride() + positions[idx].x();
+        startCells[idx] = m_board->atomCell(idx);
+    }
+    m_board->setAtomCells(cells.constData());
+
+    // games saved before fingerprints were introduced don't have it. a
+    // mismatch means the level changed since, and its moves can't be replayed
+    const QString savedHash = config.readEntry("PositionHash", QString());
+    if (!savedHash.isEmpty() && savedHash.toULongLong(0, 16) != positionHash())
+    {
+        m_board->setAtomCells(startCells.constData());
+        return false;
+    }
+
+    for(int idx=0; idx<m_atoms.count(); ++idx)
+    {
+        const QPoint& pos = positions.at(idx);
         m_atoms.at(idx)->setFieldXY(pos.x(), pos.y());
         m_atoms.at(idx)->setPos( toPixX(pos.x()), toPixY(pos.y()) );
     }
+    updateAtomGrid();
+
     // fill undo history
     m_numMoves = config.readEntry("MoveCount", 0);
 
@@ -757,6 +791,7 @@ void PlayField::loadGame( const KConfigGroup& config )
     m_selIdx = config.readEntry("SelectedAtom", 0);
     m_levelFinished = config.readEntry("LevelFinished", false);
     updateArrows();
+    return true;
 }
 
 void PlayField::showMessage( const QString& message )
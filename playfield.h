@@ -25,10 +25,12 @@
 #define PLAYFIELD_H
 #include <QGraphicsScene>
 #include <KGameRenderer>
+#include <QHash>
 #include <QList>
 #include <QStack>
 
 #include "commondefs.h"
+#include "boardstate.h"
 
 #define MIN_ELEM_SIZE 30
 
@@ -39,6 +41,7 @@ class MoleculePreviewItem;
 class QTimeLine;
 class KGamePopupItem;
 class LevelData;
+class Tablebase;
 
 /**
  *  KAtomic level playfield
@@ -47,7 +50,7 @@ class PlayField : public QGraphicsScene
 {
     Q_OBJECT
 public:
-    enum Direction { Up=0, Down, Left, Right };
+    enum Direction { Up=KAtomic::Up, Down=KAtomic::Down, Left=KAtomic::Left, Right=KAtomic::Right };
     explicit PlayField( QObject *parent );
     virtual ~PlayField();
     /**
@@ -58,6 +61,23 @@ public:
      *  Loads level
      */
     void setLevelData(const LevelData* level);
+    /**
+     *  Sets the file of the current level's tablebase, used for hints. It is
+     *  only read once a hint is asked for, and forgotten on the next
+     *  setLevelData()
+     */
+    void setTablebaseFileName(const QString& fileName);
+    /**
+     *  Moves the current position needs at least to finish the molecule,
+     *  -1 if it can't be finished or there is no tablebase for the level
+     */
+    int optimalMovesLeft();
+    /**
+     *  First move of a shortest solution from the current position, as the
+     *  index of the atom (the same as in saveGame()) and its direction
+     *  @return false if there is none or there is no tablebase for the level
+     */
+    bool bestNextMove(int* atom, Direction* dir);
     /**
      *  Sets animation speed (0-slow, 1-normal, 2-fast)
      */
@@ -73,12 +93,19 @@ public:
     void saveGame(KConfigGroup& config) const;
     /**
      *  Loads game from config object
+     *  @return false, leaving the game alone, if the saved atom placement
+     *  doesn't match the level it was saved for
      */
-    void loadGame(const KConfigGroup& config);
+    bool loadGame(const KConfigGroup& config);
     /**
      *  Returns whether level is finished already
      */
     bool isLevelFinished() const { return m_levelFinished; }
+    /**
+     *  Hash identifying the current atom placement (see BoardState::hash()),
+     *  0 if no level is loaded
+     */
+    quint64 positionHash() const { return m_board ? m_board->hash() : 0; }
     /**
      * Displays a passive popup message at the bottom of the scene
      */
@@ -93,6 +120,11 @@ public:
     KGameRenderer* renderer() { return &m_renderer; }
 
 public slots:
+    /**
+     *  Selects the atom to move next on a shortest way to the molecule and
+     *  tells where to move it
+     */
+    void showHint();
     /**
      *  Selects next atom
      */
@@ -145,9 +177,17 @@ private:
      */
     void updateBackground();
     /**
-     *  Returns true if Field cell (x,y) is empty, i.e. it isn't a wall and has no atom
+     *  Returns index (in m_atoms) of the atom placed in cell (x,y) or -1 if there is none
+     */
+    int atomIndexAt(int x, int y) const;
+    /**
+     *  Refills m_atomGrid from atom positions in m_board
      */
-    bool cellIsEmpty(int x, int y) const;
+    void updateAtomGrid();
+    /**
+     *  Selects atom idx. Returns false if it can't move anywhere
+     */
+    bool selectAtom(int idx);
     /**
      *  Returns true if atom animation is running
      */
@@ -157,8 +197,13 @@ private:
     inline int toPixY( int fieldY ) const { return fieldY*m_elemSize; }
     inline int toFieldX( int pixX ) const { return pixX/m_elemSize; }
     inline int toFieldY( int pixY ) const { return pixY/m_elemSize; }
-    inline int fieldCenterX() const { return toPixX(0) + m_elemSize*FIELD_SIZE/2; }
-    inline int fieldCenterY() const { return toPixY(0) + m_elemSize*FIELD_SIZE/2; }
+    inline int fieldCenterX() const { return toPixX(0) + m_elemSize*fieldWidth()/2; }
+    inline int fieldCenterY() const { return toPixY(0) + m_elemSize*fieldHeight()/2; }
+    /**
+     *  Field size of the current level, in cells (FIELD_SIZE if there's no level)
+     */
+    inline int fieldWidth() const { return m_levelData ? m_levelData->width() : FIELD_SIZE; }
+    inline int fieldHeight() const { return m_levelData ? m_levelData->height() : FIELD_SIZE; }
 
     /**
      * Renderer object
@@ -172,6 +217,22 @@ private:
      * Level Data
      */
     const LevelData* m_levelData;
+    /**
+     *  Game position. Atom indexes are the same as in m_atoms
+     */
+    BoardState* m_board;
+    /**
+     *  Opens the tablebase of the level on first use
+     *  @return the tablebase, 0 if there is none for the level
+     */
+    Tablebase* tablebase();
+    /**
+     *  Distances to the molecule for hints, 0 if there are none for the level
+     *  or they haven't been needed yet
+     */
+    Tablebase* m_tablebase;
+    QString m_tablebaseFileName;
+    bool m_tablebaseOpened;
     /**
      *  Element (i.e. atom, wall, arrow) size
      */
@@ -180,6 +241,13 @@ private:
      *  List of atom QGraphicsItems
      */
     QList<AtomFieldItem*> m_atoms;
+    /**
+     *  Index (in m_atoms) of the atom in each occupied field cell, by
+     *  y*fieldWidth() + x. Keyed by cell rather than a per-cell array so it
+     *  follows the atom count on large fields.
+     *  Updated whenever a move, undo or redo is committed
+     */
+    QHash<int, int> m_atomGrid;
     /**
      *  Arrow items
      */
@@ -0,0 +1,221 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "rankedbfssolver.h"
+
+#include <QElapsedTimer>
+
+#include <vector>
+
+#include "atomclasses.h"
+#include "stateranking.h"
+
+namespace
+{
+
+template<class Board>
+class RankedBreadthFirstSearch
+{
+public:
+    typedef typename Board::Cell Cell;
+
+    static SolverResult run(const LevelData* level, const SolverOptions& options)
+    {
+        RankedBreadthFirstSearch search(level, options);
+        return search.solve();
+    }
+
+private:
+    enum { Unseen = 0xff };
+
+    RankedBreadthFirstSearch(const LevelData* level, const SolverOptions& options)
+        : m_level(level), m_options(options), m_board(level), m_atomCount(m_board.atomCount()),
+        m_ranking(level), m_cells(m_atomCount), m_expanded(0), m_aborted(false)
+    {
+    }
+
+    SolverResult solve()
+    {
+        m_timer.start();
+        SolverResult result;
+        const quint64 count = m_ranking.stateCount();
+        if (count == 0 || count > m_options.memoryLimit)
+            return result;
+
+        for (int i = 0; i < m_atomCount; ++i)
+            m_cells[i] = m_board.atomCell(i);
+        if (m_board.isSolved())
+        {
+            result.status = SolverResult::Solved;
+            result.storedStates = 1;
+            return result;
+        }
+        m_depths.assign(count, quint8(Unseen));
+        m_depths[m_ranking.rank(m_cells.data())] = 0;
+        result.storedStates = 1;
+
+        result.status = SolverResult::Unsolvable;
+        for (int depth = 0; ; ++depth)
+        {
+            // the next depth wouldn't fit into a byte
+            if (depth + 1 == Unseen)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            quint64 found = count;
+            const quint64 added = expand(depth, &found);
+            if (found != count)
+            {
+                result.status = SolverResult::Solved;
+                result.moves = path(found, depth + 1);
+                break;
+            }
+            if (m_aborted)
+            {
+                result.status = SolverResult::Aborted;
+                break;
+            }
+            if (added == 0)
+                break;
+            result.storedStates += added;
+        }
+
+        result.expandedStates = m_expanded;
+        return result;
+    }
+
+    /**
+     *  Marks the successors of all positions at depth
+     *  @param found set to the rank of a solved successor, if there is one
+     *  @return number of newly reached positions
+     */
+    quint64 expand(int depth, quint64* found)
+    {
+        MoveList moves;
+        quint64 added = 0;
+        for (quint64 idx = 0; idx < m_depths.size() && !m_aborted; ++idx)
+        {
+            if (m_depths[idx] != depth)
+                continue;
+            m_ranking.unrank(idx, m_cells.data());
+            m_board.assignCells(m_cells.data());
+            m_board.generateMoves(&moves);
+            if ((++m_expanded & 0xfff) == 0 && m_options.timeLimit && m_timer.elapsed() > m_options.timeLimit * 1000)
+                m_aborted = true;
+
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                m_board.moveAtom(atom, dir, moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+
+                // positions with an atom in a dead cell have no rank
+                if (!Solver::movedToDeadCell(m_level, m_board, atom))
+                {
+                    const quint64 child = m_ranking.rank(m_cells.data());
+                    if (m_depths[child] == Unseen)
+                    {
+                        m_depths[child] = depth + 1;
+                        added++;
+                        if (m_board.isSolved())
+                        {
+                            *found = child;
+                            return added;
+                        }
+                    }
+                }
+
+                m_board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+                m_cells[atom] = m_board.atomCell(atom);
+            }
+        }
+        return added;
+    }
+
+    /**
+     *  Moves from the start to position target at depth, found by looking
+     *  for the position each one came from at the depth before it
+     */
+    QVector<SolverMove> path(quint64 target, int depth)
+    {
+        QVector<SolverMove> moves;
+        QVector<int> fromCells;
+        MoveList list;
+        for (--depth; depth >= 0; --depth)
+        {
+            bool found = false;
+            for (quint64 idx = 0; idx < m_depths.size() && !found; ++idx)
+            {
+                if (m_depths[idx] != depth)
+                    continue;
+                m_ranking.unrank(idx, m_cells.data());
+                m_board.assignCells(m_cells.data());
+                m_board.generateMoves(&list);
+                for (int m = 0; m < list.count && !found; ++m)
+                {
+                    const int atom = list.atoms[m];
+                    const KAtomic::Direction dir = static_cast<KAtomic::Direction>(list.dirs[m]);
+                    const int from = m_cells[atom];
+                    m_board.moveAtom(atom, dir, list.distances[m]);
+                    m_cells[atom] = m_board.atomCell(atom);
+                    if (!Solver::movedToDeadCell(m_level, m_board, atom)
+                        && m_ranking.rank(m_cells.data()) == target)
+                    {
+                        SolverMove mv;
+                        mv.atom = atom;
+                        mv.dir = dir;
+                        mv.numCells = list.distances[m];
+                        moves.prepend(mv);
+                        fromCells.prepend(from);
+                        target = idx;
+                        found = true;
+                    }
+                    m_board.moveAtom(atom, BoardState::opposite(dir), list.distances[m]);
+                    m_cells[atom] = m_board.atomCell(atom);
+                }
+            }
+        }
+        Board start(m_level);
+        AtomClasses::resolveAtoms(&start, &moves, fromCells);
+        return moves;
+    }
+
+    const LevelData* m_level;
+    const SolverOptions& m_options;
+    Board m_board;
+    const int m_atomCount;
+    const StateRanking m_ranking;
+    std::vector<Cell> m_cells;
+    // depth each position was reached at, by rank, Unseen for the others
+    std::vector<quint8> m_depths;
+    QElapsedTimer m_timer;
+    quint64 m_expanded;
+    bool m_aborted;
+};
+
+}
+
+SolverResult RankedBfsSolver::solve(const LevelData* level)
+{
+    return searchOnBoard<RankedBreadthFirstSearch>(level);
+}
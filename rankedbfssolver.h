@@ -0,0 +1,46 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_RANKEDBFSSOLVER_H
+#define KATOMIC_RANKEDBFSSOLVER_H
+
+#include "solver.h"
+
+/**
+ * Breadth-first search for levels with few atoms, over a flat array with one
+ * byte per position instead of a hash table.
+ *
+ * Positions are numbered by StateRanking, and the array holds the depth each
+ * one was first reached at. Every depth is expanded by sweeping the whole
+ * array for positions of that depth, so the search is only worth it when
+ * most numbers belong to reachable positions. The solution is recovered by
+ * sweeping the depths backwards for a position that has a move to the next
+ * one of the path. Levels with more positions than fit into the memory
+ * budget are not searched.
+ */
+class RankedBfsSolver : public Solver
+{
+public:
+    explicit RankedBfsSolver(const SolverOptions& options) : Solver(options) {}
+
+    SolverResult solve(const LevelData* level) Q_DECL_OVERRIDE;
+};
+
+#endif
@@ -0,0 +1,283 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "solutionoptimizer.h"
+
+#include <QHash>
+
+#include <string.h>
+#include <vector>
+
+#include "atomclasses.h"
+
+namespace
+{
+
+template<class Board>
+class Shortener
+{
+public:
+    typedef typename Board::Cell Cell;
+
+    Shortener(const LevelData* level, int searchDepth)
+        : m_level(level), m_searchDepth(searchDepth), m_board(level), m_atomCount(m_board.atomCount()),
+        m_classes(m_board), m_startCells(m_atomCount), m_cells(m_atomCount), m_moveLists(searchDepth),
+        m_bestSaving(0), m_bestTo(0)
+    {
+        for (int i = 0; i < m_atomCount; ++i)
+            m_startCells[i] = m_board.atomCell(i);
+    }
+
+    bool run(QVector<SolverMove>* moves)
+    {
+        // steps name the moving atom by its cell, so that they stay valid
+        // when a replacement swaps identical atoms
+        m_board.assignCells(m_startCells.data());
+        foreach (const SolverMove& mv, *moves)
+        {
+            if (mv.atom < 0 || mv.atom >= m_atomCount || mv.numCells <= 0
+                || m_board.slideDistance(mv.atom, mv.dir) != mv.numCells)
+                return false;
+            const Step step = { int(m_board.atomCell(mv.atom)), mv.dir };
+            m_steps.push_back(step);
+            m_board.moveAtom(mv.atom, mv.dir, mv.numCells);
+        }
+        if (!m_board.isSolved())
+            return false;
+
+        replay();
+        for (bool changed = true; changed; )
+        {
+            changed = false;
+            // a single move can only be replaced by none, which replay()
+            // already takes care of
+            for (int from = 0; from + 2 <= int(m_steps.size()); ++from)
+            {
+                while (shortenFrom(from))
+                    changed = true;
+            }
+        }
+
+        moves->clear();
+        m_board.assignCells(m_startCells.data());
+        for (size_t i = 0; i < m_steps.size(); ++i)
+        {
+            SolverMove mv;
+            mv.atom = atomAt(m_steps[i].fromCell);
+            mv.dir = m_steps[i].dir;
+            mv.numCells = m_board.slideDistance(mv.atom, mv.dir);
+            m_board.moveAtom(mv.atom, mv.dir, mv.numCells);
+            moves->append(mv);
+        }
+        return true;
+    }
+
+private:
+    struct Step
+    {
+        int fromCell;
+        KAtomic::Direction dir;
+    };
+
+    int atomAt(int cell) const
+    {
+        for (int i = 0; i < m_atomCount; ++i)
+        {
+            if (m_board.atomCell(i) == cell)
+                return i;
+        }
+        return -1;
+    }
+
+    const Cell* position(int idx) const { return &m_positions[size_t(idx) * m_atomCount]; }
+    int positionCount() const { return m_hashes.size(); }
+
+    /**
+     *  Index of the board's position within the solution, -1 if it isn't
+     *  one of its positions
+     */
+    int find()
+    {
+        const QHash<quint64, int>::const_iterator it = m_index.constFind(m_board.hash());
+        if (it == m_index.constEnd())
+            return -1;
+        for (int i = 0; i < m_atomCount; ++i)
+            m_cells[i] = m_board.atomCell(i);
+        m_classes.canonicalize(m_cells.data());
+        return memcmp(m_cells.data(), position(it.value()), m_atomCount * sizeof(Cell)) == 0 ? it.value() : -1;
+    }
+
+    void addPosition()
+    {
+        for (int i = 0; i < m_atomCount; ++i)
+            m_cells[i] = m_board.atomCell(i);
+        m_classes.canonicalize(m_cells.data());
+        m_positions.insert(m_positions.end(), m_cells.begin(), m_cells.end());
+        m_index.insert(m_board.hash(), positionCount());
+        m_hashes.push_back(m_board.hash());
+    }
+
+    /**
+     *  Replays m_steps from the start and indexes the positions passed,
+     *  dropping the moves of every loop back to an earlier position and
+     *  those after the first goal position
+     */
+    void replay()
+    {
+        m_positions.clear();
+        m_hashes.clear();
+        m_index.clear();
+        m_board.assignCells(m_startCells.data());
+        addPosition();
+
+        std::vector<Step> steps;
+        for (size_t i = 0; i < m_steps.size() && !m_board.isSolved(); ++i)
+        {
+            const int atom = atomAt(m_steps[i].fromCell);
+            m_board.moveAtom(atom, m_steps[i].dir, m_board.slideDistance(atom, m_steps[i].dir));
+            const int seen = find();
+            if (seen < 0)
+            {
+                steps.push_back(m_steps[i]);
+                addPosition();
+                continue;
+            }
+            for (int k = seen + 1; k < positionCount(); ++k)
+                m_index.remove(m_hashes[k]);
+            m_hashes.resize(seen + 1);
+            m_positions.resize(size_t(seen + 1) * m_atomCount);
+            steps.resize(seen);
+        }
+        m_steps.swap(steps);
+    }
+
+    /**
+     *  Replaces the moves after position from by the shortcut saving the
+     *  most moves, if there is one
+     */
+    bool shortenFrom(int from)
+    {
+        m_board.assignCells(position(from));
+        m_bestSaving = 0;
+        search(from, 0);
+        if (m_bestSaving == 0)
+            return false;
+
+        std::vector<Step> steps(m_steps.begin(), m_steps.begin() + from);
+        steps.insert(steps.end(), m_bestPath.begin(), m_bestPath.end());
+        steps.insert(steps.end(), m_steps.begin() + m_bestTo, m_steps.end());
+        m_steps.swap(steps);
+        replay();
+        return true;
+    }
+
+    void search(int from, int depth)
+    {
+        // even reaching the goal from here would save no more moves
+        const int last = positionCount() - 1;
+        if (last - from - depth <= m_bestSaving)
+            return;
+
+        if (depth > 0)
+        {
+            // any goal position will do, not only the one the solution ends in
+            const bool solved = m_board.isSolved();
+            const int to = solved ? last : find();
+            if (to - from - depth > m_bestSaving)
+            {
+                m_bestSaving = to - from - depth;
+                m_bestTo = to;
+                m_bestPath = m_path;
+            }
+            if (solved)
+                return;
+        }
+        if (depth == m_searchDepth)
+            return;
+
+        MoveList& moves = m_moveLists[depth];
+        m_board.generateMoves(&moves);
+        for (int m = 0; m < moves.count; ++m)
+        {
+            const int atom = moves.atoms[m];
+            const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+            const Step step = { int(m_board.atomCell(atom)), dir };
+            m_board.moveAtom(atom, dir, moves.distances[m]);
+            if (!Solver::movedToDeadCell(m_level, m_board, atom))
+            {
+                m_path.push_back(step);
+                search(from, depth + 1);
+                m_path.pop_back();
+            }
+            m_board.moveAtom(atom, BoardState::opposite(dir), moves.distances[m]);
+        }
+    }
+
+    const LevelData* m_level;
+    const int m_searchDepth;
+    Board m_board;
+    const int m_atomCount;
+    const AtomClasses m_classes;
+    std::vector<Cell> m_startCells;
+    std::vector<Cell> m_cells;
+    std::vector<MoveList> m_moveLists;
+
+    std::vector<Step> m_steps;
+    // canonical cells and hash of each position of m_steps, starting with
+    // the level's start
+    std::vector<Cell> m_positions;
+    std::vector<quint64> m_hashes;
+    QHash<quint64, int> m_index;
+
+    std::vector<Step> m_path;
+    std::vector<Step> m_bestPath;
+    int m_bestSaving;
+    int m_bestTo;
+};
+
+template<class Board>
+bool optimizeOnBoard(const LevelData* level, int searchDepth, QVector<SolverMove>* moves)
+{
+    Shortener<Board> shortener(level, searchDepth);
+    return shortener.run(moves);
+}
+
+}
+
+bool SolutionOptimizer::optimize(const LevelData* level, QVector<SolverMove>* moves) const
+{
+    QVector<SolverMove> shortened = *moves;
+    bool valid = false;
+    switch (level->boardSize())
+    {
+#define KATOMIC_OPTIMIZE_ON_BOARD(N) \
+        case N: \
+            valid = optimizeOnBoard<FixedBoardState<N, N> >(level, m_searchDepth, &shortened); \
+            break;
+        KATOMIC_FOR_EACH_BOARD_SIZE(KATOMIC_OPTIMIZE_ON_BOARD)
+#undef KATOMIC_OPTIMIZE_ON_BOARD
+        default:
+            valid = optimizeOnBoard<SparseBoardState>(level, m_searchDepth, &shortened);
+    }
+    if (valid)
+        *moves = shortened;
+    return valid;
+}
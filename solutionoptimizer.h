@@ -0,0 +1,69 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_SOLUTIONOPTIMIZER_H
+#define KATOMIC_SOLUTIONOPTIMIZER_H
+
+#include <QVector>
+
+#include "solver.h"
+
+/**
+ * Shortens solutions found by players (see PlayField::saveGame()) or by
+ * solvers that don't guarantee optimal ones, such as BeamSolver.
+ *
+ * Stretches of the solution that return to a position seen before are cut
+ * out first. Then a depth limited search is started from every position of
+ * the solution, and whenever it reaches a later position of the solution, or
+ * any goal position, in fewer moves than the solution does, the moves in
+ * between are replaced. This is repeated until nothing changes, so the
+ * result has no shortcut of up to searchDepth moves left, but is not
+ * necessarily optimal.
+ *
+ * Positions that only differ in the order of identical atoms are the same
+ * position, so replacements may move a different but identical atom.
+ */
+class SolutionOptimizer
+{
+public:
+    /**
+     *  Largest searchDepth worth waiting for
+     */
+    enum { MaxSearchDepth = 8 };
+
+    /**
+     *  @param searchDepth longest replacement tried for a stretch of moves,
+     *  the search from each position grows exponentially with it. Clamped
+     *  to 1..MaxSearchDepth
+     */
+    explicit SolutionOptimizer(int searchDepth = 3) : m_searchDepth(qBound(1, searchDepth, int(MaxSearchDepth))) {}
+
+    /**
+     *  Replaces moves by the shortest equivalent solution found.
+     *  @return false, leaving moves alone, if they aren't legal moves
+     *  solving level
+     */
+    bool optimize(const LevelData* level, QVector<SolverMove>* moves) const;
+
+private:
+    int m_searchDepth;
+};
+
+#endif
@@ -0,0 +1,92 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "solver.h"
+
+#include "beamsolver.h"
+#include "bfssolver.h"
+#include "bidirectionalsolver.h"
+#include "externalbfssolver.h"
+#include "idasolver.h"
+#include "parallelbfssolver.h"
+#include "parallelidasolver.h"
+#include "rankedbfssolver.h"
+
+Solver* Solver::create(const QString& name, const SolverOptions& options)
+{
+    if (name == QLatin1String("bfs"))
+        return new BfsSolver(options);
+    if (name == QLatin1String("ida"))
+        return new IdaSolver(options);
+    if (name == QLatin1String("pbfs"))
+        return new ParallelBfsSolver(options);
+    if (name == QLatin1String("pida"))
+        return new ParallelIdaSolver(options);
+    if (name == QLatin1String("bidir"))
+        return new BidirectionalSolver(options);
+    if (name == QLatin1String("ebfs"))
+        return new ExternalBfsSolver(options);
+    if (name == QLatin1String("rbfs"))
+        return new RankedBfsSolver(options);
+    if (name == QLatin1String("beam"))
+        return new BeamSolver(options);
+    return 0;
+}
+
+QStringList Solver::names()
+{
+    return QStringList() << QStringLiteral("bfs") << QStringLiteral("ida") << QStringLiteral("pbfs") << QStringLiteral("pida") << QStringLiteral("bidir") << QStringLiteral("ebfs")
+        << QStringLiteral("rbfs") << QStringLiteral("beam");
+}
+
+char Solver::directionLetter(KAtomic::Direction dir)
+{
+    switch (dir)
+    {
+        case KAtomic::Up:
+            return 'U';
+        case KAtomic::Down:
+            return 'D';
+        case KAtomic::Left:
+            return 'L';
+        case KAtomic::Right:
+            return 'R';
+    }
+    return '?';
+}
+
+void Solver::completeMoves(const LevelData* level, QVector<SolverMove>* moves)
+{
+    BoardState* board = BoardState::create(level);
+    for (int i = 0; i < moves->count(); ++i)
+        (*moves)[i].numCells = board->applyMove((*moves)[i].atom, (*moves)[i].dir);
+    delete board;
+}
+
+bool Solver::startsInDeadCell(const LevelData* level)
+{
+    foreach (const LevelData::Element& el, level->atomElements())
+    {
+        if (level->isDeadCell(el.atom, el.y*level->stride() + el.x))
+            return true;
+    }
+    return false;
+}
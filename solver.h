@@ -0,0 +1,230 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_SOLVER_H
+#define KATOMIC_SOLVER_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include "commondefs.h"
+#include "boardstate.h"
+
+/**
+ * One move of a solution, the same as a move the player makes in PlayField:
+ * atom atom (index within LevelData::atomElements()) slides numCells cells
+ * in direction dir
+ */
+struct SolverMove
+{
+    int atom;
+    KAtomic::Direction dir;
+    int numCells;
+};
+
+struct SolverResult
+{
+    enum Status
+    {
+        Solved,
+        /**
+         *  The whole reachable state space was searched without finding the molecule
+         */
+        Unsolvable,
+        /**
+         *  Search was stopped by the memory budget or another limit
+         */
+        Aborted
+    };
+
+    Status status;
+    /**
+     *  Solution, optimal if Solver::isOptimal()
+     */
+    QVector<SolverMove> moves;
+    /**
+     *  Positions whose moves have been generated
+     */
+    quint64 expandedStates;
+    /**
+     *  Positions kept in memory at the end of search
+     */
+    quint64 storedStates;
+
+    SolverResult() : status(Aborted), expandedStates(0), storedStates(0) {}
+};
+
+/**
+ * Receives the solutions an anytime solver finds while it keeps searching
+ * for shorter ones
+ */
+class SolverProgress
+{
+public:
+    virtual ~SolverProgress() {}
+
+    /**
+     *  Called with each solution shorter than all before it
+     *  @param elapsed milliseconds since solve() was called
+     */
+    virtual void improved(const QVector<SolverMove>& moves, qint64 elapsed) = 0;
+};
+
+struct SolverOptions
+{
+    /**
+     *  Memory budget for search data, in bytes
+     */
+    quint64 memoryLimit;
+    /**
+     *  Time budget of one solve() call in seconds, 0 for no limit
+     */
+    int timeLimit;
+    /**
+     *  Levels with at least this many atoms are searched with pattern
+     *  databases (see PatternDatabaseBound) where the solver supports them,
+     *  0 to never use them
+     */
+    int patternDatabaseAtoms;
+    /**
+     *  Where pattern databases are kept between runs, empty to not keep them
+     */
+    QString patternDatabaseDir;
+    /**
+     *  Threads used by solvers that search in parallel, 0 for one per core
+     */
+    int threadCount;
+    /**
+     *  Where solvers that search on disk put their files, empty for the
+     *  system's temporary directory
+     */
+    QString scratchDir;
+    /**
+     *  Size of the transposition table of iterative deepening solvers in
+     *  bytes, 0 to search without one
+     */
+    quint64 transpositionTableSize;
+    /**
+     *  Iterative deepening solvers give up on solutions longer than this,
+     *  0 for no limit
+     */
+    int maxDepth;
+    /**
+     *  Positions kept per depth by beam search at first
+     */
+    int beamWidth;
+    /**
+     *  Told about the improving solutions of anytime solvers, may be 0
+     */
+    SolverProgress* progress;
+
+    SolverOptions()
+        : memoryLimit(Q_UINT64_C(4) << 30), timeLimit(0), patternDatabaseAtoms(8), threadCount(0),
+        transpositionTableSize(Q_UINT64_C(256) << 20), maxDepth(0), beamWidth(1024), progress(0) {}
+};
+
+/**
+ * Base of the level solvers used by the katomic-solve tool.
+ *
+ * Solvers work on the headless board core (see BoardState) with the same move
+ * rules as PlayField. Like BoardState::create(), they pick the board
+ * specialisation matching the level, so the search loops are compiled for it.
+ */
+class Solver
+{
+public:
+    explicit Solver(const SolverOptions& options) : m_options(options) {}
+    virtual ~Solver() {}
+
+    virtual SolverResult solve(const LevelData* level) = 0;
+
+    /**
+     *  Whether the solutions solve() returns are always the shortest ones
+     */
+    virtual bool isOptimal() const { return true; }
+    /**
+     *  Whether solve() uses SolverOptions::threadCount threads
+     */
+    virtual bool isParallel() const { return false; }
+
+    /**
+     *  Creates the solver called name (see names()), 0 if there is no such solver
+     */
+    static Solver* create(const QString& name, const SolverOptions& options);
+    static QStringList names();
+
+    /**
+     *  Single letter name of dir as used in move lists: U, D, L or R
+     */
+    static char directionLetter(KAtomic::Direction dir);
+
+    /**
+     *  Whether moving atom took board to a position no solution goes through,
+     *  as the atom now stands in a dead cell (see LevelData::isDeadCell()).
+     *  Searches drop such positions instead of storing them
+     */
+    template<class Board>
+    static bool movedToDeadCell(const LevelData* level, const Board& board, int atom)
+    {
+        return level->isDeadCell(board.atomNum(atom), board.atomCell(atom));
+    }
+
+protected:
+    /**
+     *  Fills in numCells of moves by replaying them from the level's start
+     */
+    static void completeMoves(const LevelData* level, QVector<SolverMove>* moves);
+
+    /**
+     *  Whether some atom of the level's start position is in a dead cell
+     *  (see LevelData::isDeadCell()), so the level can't be solved
+     */
+    static bool startsInDeadCell(const LevelData* level);
+
+    /**
+     *  Runs Search<Board>::run(level, options) with the board class matching
+     *  level, picked the same way as in BoardState::create()
+     */
+    template<template<class> class Search>
+    SolverResult searchOnBoard(const LevelData* level) const
+    {
+        if (startsInDeadCell(level))
+        {
+            SolverResult result;
+            result.status = SolverResult::Unsolvable;
+            return result;
+        }
+
+        switch (level->boardSize())
+        {
+#define KATOMIC_SEARCH_ON_BOARD(N) \
+            case N: \
+                return Search<FixedBoardState<N, N> >::run(level, m_options);
+            KATOMIC_FOR_EACH_BOARD_SIZE(KATOMIC_SEARCH_ON_BOARD)
+#undef KATOMIC_SEARCH_ON_BOARD
+        }
+        return Search<SparseBoardState>::run(level, m_options);
+    }
+
+    SolverOptions m_options;
+};
+
+#endif
@@ -0,0 +1,414 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QCommandLineOption>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QStandardPaths>
+#include <QTextStream>
+#include <QThread>
+
+#include <KConfig>
+#include <KConfigGroup>
+
+#include "beamsolver.h"
+#include "levelset.h"
+#include "molecule.h"
+#include "solutionoptimizer.h"
+#include "solver.h"
+#include "tablebase.h"
+
+// katomic-solve: prints solutions of the levels of a level set, optimal ones
+// unless the mode says otherwise (see Solver::isOptimal())
+
+static QString movesToString(const QVector<SolverMove>& moves)
+{
+    QStringList list;
+    foreach (const SolverMove& mv, moves)
+        list << QString::number(mv.atom) + QLatin1Char(Solver::directionLetter(mv.dir)) + QString::number(mv.numCells);
+    return list.join(QLatin1Char(' '));
+}
+
+// loads a level set given by file name or by the name of an installed one
+static bool loadLevelSet(LevelSet* levelSet, const QString& name)
+{
+    const bool loaded = QFileInfo(name).isFile() ? levelSet->loadFromFile(name) : levelSet->load(name);
+    return loaded && levelSet->levelCount() > 0;
+}
+
+// reads moves in the format of movesToString()
+static bool parseMoves(const QStringList& words, QVector<SolverMove>* moves)
+{
+    foreach (const QString& word, words)
+    {
+        int letter = 0;
+        while (letter < word.length() && word.at(letter).isDigit())
+            ++letter;
+        const int dir = letter < word.length() ? QStringLiteral("UDLR").indexOf(word.at(letter)) : -1;
+        bool ok = false;
+        SolverMove mv;
+        mv.atom = word.left(letter).toInt();
+        mv.numCells = word.mid(letter + 1).toInt(&ok);
+        if (letter == 0 || dir < 0 || !ok)
+            return false;
+        mv.dir = static_cast<KAtomic::Direction>(dir);
+        moves->append(mv);
+    }
+    return true;
+}
+
+// shortens the solutions of --shorten and prints what became of them
+class SolutionShortener
+{
+public:
+    SolutionShortener(int searchDepth, QTextStream* out)
+        : solutions(0), savedMoves(0), m_optimizer(searchDepth), m_out(out) {}
+
+    void shorten(const QString& source, const LevelSet& levelSet, int levelNum, QVector<SolverMove> moves)
+    {
+        const LevelData* level = levelSet.levelData(levelNum);
+        const int before = moves.count();
+        *m_out << source << ", level " << levelNum << ": ";
+        if (!level || !m_optimizer.optimize(level, &moves))
+        {
+            *m_out << "not a solution of the level" << endl;
+            return;
+        }
+        solutions++;
+        savedMoves += before - moves.count();
+        *m_out << before << " -> " << moves.count() << " moves" << endl;
+        *m_out << "  " << movesToString(moves) << endl;
+    }
+
+    // a saved game of the game's own format, see PlayField::saveGame()
+    void shortenSavedGame(const QString& fileName, QTextStream* err)
+    {
+        KConfig config(fileName, KConfig::SimpleConfig);
+        const KConfigGroup group = config.group("Savegame");
+        QString levelSetName = group.readEntry("LevelSet");
+        if (levelSetName.isEmpty())
+            levelSetName = QStringLiteral(DEFAULT_LEVELSET_NAME);
+        LevelSet levelSet;
+        if (!loadLevelSet(&levelSet, levelSetName))
+        {
+            *err << fileName << ": can't load level set " << levelSetName << endl;
+            return;
+        }
+
+        QVector<SolverMove> moves;
+        const int moveCount = group.readEntry("MoveCount", 0);
+        for (int i = 0; i < moveCount; ++i)
+        {
+            const QList<int> entry = group.readEntry(QStringLiteral("Move_%1").arg(i), QList<int>());
+            if (entry.count() != 3 || entry.at(1) < KAtomic::Up || entry.at(1) > KAtomic::Right)
+            {
+                *err << fileName << ": broken move " << i << endl;
+                return;
+            }
+            SolverMove mv;
+            mv.atom = entry.at(0);
+            mv.dir = static_cast<KAtomic::Direction>(entry.at(1));
+            mv.numCells = entry.at(2);
+            moves.append(mv);
+        }
+        shorten(fileName, levelSet, group.readEntry("Level", 1), moves);
+    }
+
+    // lines of <level> <moves>, solutions of levels of the level set levelSetName
+    void shortenMoveLists(const QString& fileName, const QString& levelSetName, QTextStream* err)
+    {
+        LevelSet levelSet;
+        if (!loadLevelSet(&levelSet, levelSetName))
+        {
+            *err << fileName << ": can't load level set " << levelSetName << endl;
+            return;
+        }
+        QFile file(fileName);
+        if (!file.open(QIODevice::ReadOnly | QIODevice::Text))
+        {
+            *err << "can't open " << fileName << endl;
+            return;
+        }
+        QTextStream in(&file);
+        for (int lineNum = 1; !in.atEnd(); ++lineNum)
+        {
+            QStringList words = in.readLine().split(QLatin1Char(' '), QString::SkipEmptyParts);
+            if (words.isEmpty() || words.first().startsWith(QLatin1Char('#')))
+                continue;
+            bool ok = false;
+            const int levelNum = words.takeFirst().toInt(&ok);
+            QVector<SolverMove> moves;
+            if (!ok || !parseMoves(words, &moves))
+            {
+                *err << fileName << ":" << lineNum << ": can't read the moves" << endl;
+                continue;
+            }
+            shorten(QStringLiteral("%1:%2").arg(fileName).arg(lineNum), levelSet, levelNum, moves);
+        }
+    }
+
+    int solutions;
+    int savedMoves;
+
+private:
+    SolutionOptimizer m_optimizer;
+    QTextStream* m_out;
+};
+
+// prints the solutions of anytime modes as they improve
+class ProgressPrinter : public SolverProgress
+{
+public:
+    explicit ProgressPrinter(QTextStream* out) : levelNum(0), m_out(out) {}
+
+    void improved(const QVector<SolverMove>& moves, qint64 elapsed) Q_DECL_OVERRIDE
+    {
+        *m_out << "Level " << levelNum << ": found " << moves.count() << " moves after " << elapsed / 1000.0 << " s" << endl;
+    }
+
+    int levelNum;
+
+private:
+    QTextStream* m_out;
+};
+
+int main(int argc, char **argv)
+{
+    QCoreApplication app(argc, argv);
+    // so that installed level sets are found the same way the game finds them
+    QCoreApplication::setApplicationName(QStringLiteral("katomic"));
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription(QStringLiteral("Solves KAtomic levels. All modes but beam find the shortest solutions.\n"
+        "Moves are printed as <atom><direction><cells>, atoms numbered in level file order."));
+    parser.addHelpOption();
+    QCommandLineOption modeOption(QStringList() << QStringLiteral("m") << QStringLiteral("mode"),
+            QStringLiteral("Search algorithm, one of: %1.").arg(Solver::names().join(QStringLiteral(", "))),
+            QStringLiteral("mode"), QStringLiteral("bfs"));
+    QCommandLineOption levelOption(QStringList() << QStringLiteral("l") << QStringLiteral("level"),
+            QStringLiteral("Solve only level <n>."), QStringLiteral("n"));
+    QCommandLineOption memoryOption(QStringLiteral("memory"),
+            QStringLiteral("Memory budget of the search in MiB (default 4096)."), QStringLiteral("MiB"), QStringLiteral("4096"));
+    QCommandLineOption timeOption(QStringLiteral("time"),
+            QStringLiteral("Give up on a level after <seconds> (default: no limit, %1 for beam).").arg(int(BeamSolver::DefaultTimeLimit)),
+            QStringLiteral("seconds"), QStringLiteral("0"));
+    parser.addOption(modeOption);
+    parser.addOption(levelOption);
+    parser.addOption(memoryOption);
+    QCommandLineOption pdbOption(QStringLiteral("pdb-atoms"),
+            QStringLiteral("Use pattern databases for levels with at least <n> atoms, 0 for never (default 8)."),
+            QStringLiteral("n"), QStringLiteral("8"));
+    parser.addOption(timeOption);
+    parser.addOption(pdbOption);
+    QCommandLineOption threadsOption(QStringLiteral("threads"),
+            QStringLiteral("Threads of parallel modes, 0 for one per core (default 0)."), QStringLiteral("n"), QStringLiteral("0"));
+    QCommandLineOption scalingOption(QStringLiteral("scaling"),
+            QStringLiteral("Solve each level with 1, 2, 4, ... up to the number of threads and print the speedups. Parallel modes only."));
+    parser.addOption(threadsOption);
+    parser.addOption(scalingOption);
+    QCommandLineOption scratchOption(QStringLiteral("scratch"),
+            QStringLiteral("Directory for the files of disk-based modes (default: the temporary directory)."), QStringLiteral("dir"));
+    parser.addOption(scratchOption);
+    QCommandLineOption tableOption(QStringLiteral("tt-memory"),
+            QStringLiteral("Transposition table size of IDA* modes in MiB, 0 for none (default 256)."),
+            QStringLiteral("MiB"), QStringLiteral("256"));
+    parser.addOption(tableOption);
+    QCommandLineOption maxDepthOption(QStringLiteral("max-depth"),
+            QStringLiteral("Give up when IDA* modes would look for solutions longer than <n> moves, 0 for no limit (default 0)."),
+            QStringLiteral("n"), QStringLiteral("0"));
+    parser.addOption(maxDepthOption);
+    QCommandLineOption tablebaseOption(QStringLiteral("tablebase"),
+            QStringLiteral("Instead of solving, build the tablebases the game gives hints from, in the user's data directory, "
+                           "for levels whose table fits into the memory budget."));
+    parser.addOption(tablebaseOption);
+    QCommandLineOption beamOption(QStringLiteral("beam-width"),
+            QStringLiteral("Positions kept per depth by the first pass of beam search (default 1024)."),
+            QStringLiteral("n"), QStringLiteral("1024"));
+    parser.addOption(beamOption);
+    QCommandLineOption shortenOption(QStringLiteral("shorten"),
+            QStringLiteral("Instead of solving, shorten the solutions in <file>: a saved game, which names its level set "
+                           "and level, or lines of a level number of <levelset> followed by moves as printed here. "
+                           "Can be given several times."),
+            QStringLiteral("file"));
+    QCommandLineOption shortenDepthOption(QStringLiteral("shorten-depth"),
+            QStringLiteral("Longest replacement --shorten tries for a stretch of moves, 1 to %1 (default 3).")
+                .arg(int(SolutionOptimizer::MaxSearchDepth)),
+            QStringLiteral("n"), QStringLiteral("3"));
+    parser.addOption(shortenOption);
+    parser.addOption(shortenDepthOption);
+    parser.addPositionalArgument(QStringLiteral("levelset"),
+            QStringLiteral("Level set file, or name of an installed level set (default: %1).").arg(QStringLiteral(DEFAULT_LEVELSET_NAME)));
+    parser.process(app);
+
+    QTextStream out(stdout);
+    QTextStream err(stderr);
+
+    SolverOptions options;
+    options.memoryLimit = parser.value(memoryOption).toULongLong() << 20;
+    options.timeLimit = parser.value(timeOption).toInt();
+    options.patternDatabaseAtoms = parser.value(pdbOption).toInt();
+    options.patternDatabaseDir = QStandardPaths::writableLocation(QStandardPaths::CacheLocation) + QStringLiteral("/patterns");
+    options.threadCount = parser.value(threadsOption).toInt();
+    options.scratchDir = parser.value(scratchOption);
+    options.transpositionTableSize = parser.value(tableOption).toULongLong() << 20;
+    options.maxDepth = parser.value(maxDepthOption).toInt();
+    options.beamWidth = parser.value(beamOption).toInt();
+    ProgressPrinter progress(&out);
+    options.progress = &progress;
+    if (options.threadCount <= 0)
+        options.threadCount = qMax(1, QThread::idealThreadCount());
+
+    // one solver per thread count to compare, the last one uses all threads
+    QList<Solver*> solvers;
+    if (parser.isSet(scalingOption))
+    {
+        for (int threads = 1; threads < options.threadCount; threads *= 2)
+        {
+            SolverOptions scaledOptions = options;
+            scaledOptions.threadCount = threads;
+            solvers << Solver::create(parser.value(modeOption), scaledOptions);
+        }
+    }
+    solvers << Solver::create(parser.value(modeOption), options);
+    if (!solvers.last())
+    {
+        err << "unknown mode " << parser.value(modeOption) << endl;
+        qDeleteAll(solvers);
+        return 1;
+    }
+    if (parser.isSet(scalingOption) && !solvers.last()->isParallel())
+    {
+        err << "--scaling needs a parallel mode" << endl;
+        qDeleteAll(solvers);
+        return 1;
+    }
+
+    const QStringList args = parser.positionalArguments();
+    const QString levelSetName = args.isEmpty() ? QStringLiteral(DEFAULT_LEVELSET_NAME) : args.first();
+
+    // saved games name their level set and level, only move lists use levelSetName
+    if (parser.isSet(shortenOption))
+    {
+        bool ok = false;
+        const int depth = parser.value(shortenDepthOption).toInt(&ok);
+        if (!ok || depth < 1 || depth > SolutionOptimizer::MaxSearchDepth)
+        {
+            err << "--shorten-depth must be a number from 1 to " << int(SolutionOptimizer::MaxSearchDepth) << endl;
+            qDeleteAll(solvers);
+            return 1;
+        }
+        QElapsedTimer timer;
+        timer.start();
+        SolutionShortener shortener(depth, &out);
+        foreach (const QString& fileName, parser.values(shortenOption))
+        {
+            if (fileName.endsWith(QLatin1String(".katomic")))
+                shortener.shortenSavedGame(fileName, &err);
+            else
+                shortener.shortenMoveLists(fileName, levelSetName, &err);
+        }
+        out << shortener.solutions << " solutions shortened by " << shortener.savedMoves << " moves in "
+            << timer.elapsed() / 1000.0 << " s" << endl;
+        qDeleteAll(solvers);
+        return 0;
+    }
+
+    LevelSet levelSet;
+    if (!loadLevelSet(&levelSet, levelSetName))
+    {
+        err << "can't load level set " << levelSetName << endl;
+        qDeleteAll(solvers);
+        return 1;
+    }
+
+    int first = 1;
+    int last = levelSet.levelCount();
+    if (parser.isSet(levelOption))
+        first = last = parser.value(levelOption).toInt();
+
+    for (int levelNum = first; levelNum <= last; ++levelNum)
+    {
+        const LevelData* level = levelSet.levelData(levelNum);
+        if (!level)
+        {
+            out << "Level " << levelNum << ": can't be loaded" << endl;
+            continue;
+        }
+
+        if (parser.isSet(tablebaseOption))
+        {
+            QElapsedTimer timer;
+            timer.start();
+            const qint64 known = Tablebase::build(level, levelSet.tablebaseFileName(levelNum), options.memoryLimit);
+            out << "Level " << levelNum << " (" << level->molecule()->moleculeName() << "): ";
+            if (known < 0)
+                out << "no tablebase" << endl;
+            else
+                out << "tablebase of " << known << " positions, " << timer.elapsed() / 1000.0 << " s" << endl;
+            continue;
+        }
+
+        progress.levelNum = levelNum;
+        SolverResult result;
+        double seconds = 0;
+        double firstSeconds = 0;
+        QStringList scaling;
+        foreach (Solver* solver, solvers)
+        {
+            QElapsedTimer timer;
+            timer.start();
+            result = solver->solve(level);
+            seconds = timer.elapsed() / 1000.0;
+
+            const int threads = solver == solvers.last() ? options.threadCount : 1 << scaling.count();
+            if (scaling.isEmpty())
+                firstSeconds = seconds;
+            scaling << QStringLiteral("%1 threads %2 s (%3x)").arg(threads).arg(seconds)
+                .arg(seconds > 0 ? firstSeconds / seconds : 1.0, 0, 'f', 2);
+        }
+
+        out << "Level " << levelNum << " (" << level->molecule()->moleculeName() << "): ";
+        switch (result.status)
+        {
+            case SolverResult::Solved:
+                out << result.moves.count() << (solvers.last()->isOptimal() ? " moves" : " moves, maybe not the shortest");
+                break;
+            case SolverResult::Unsolvable:
+                out << "unsolvable";
+                break;
+            case SolverResult::Aborted:
+                out << "gave up";
+                break;
+        }
+        out << ", " << result.expandedStates << " expanded, " << result.storedStates << " stored, "
+            << seconds << " s" << endl;
+        if (result.status == SolverResult::Solved)
+            out << "  " << movesToString(result.moves) << endl;
+        if (parser.isSet(scalingOption))
+            out << "  scaling: " << scaling.join(QStringLiteral(", ")) << endl;
+    }
+
+    qDeleteAll(solvers);
+    return 0;
+}
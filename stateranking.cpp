@@ -0,0 +1,94 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "stateranking.h"
+
+#include <QBitArray>
+
+StateRanking::StateRanking(const LevelData* level)
+    : m_maxClassSize(0), m_stateCount(1)
+{
+    const QList<LevelData::Element> elements = level->atomElements();
+    const int stride = level->stride();
+    QBitArray classified(elements.count());
+    for (int i = 0; i < elements.count(); ++i)
+    {
+        if (classified.testBit(i))
+            continue;
+        AtomClass cls;
+        for (int j = i; j < elements.count(); ++j)
+        {
+            if (elements.at(j).atom == elements.at(i).atom)
+            {
+                cls.atoms.append(j);
+                classified.setBit(j);
+            }
+        }
+
+        const int num = elements.at(i).atom;
+        cls.freeIndex.fill(-1, level->cellCount());
+        for (int y = 0; y < level->height(); ++y)
+            for (int x = 0; x < level->width(); ++x)
+            {
+                const int cell = y*stride + x;
+                if (!level->containsWallAt(x, y) && !level->isDeadCell(num, cell))
+                {
+                    cls.freeIndex[cell] = cls.freeCells.count();
+                    cls.freeCells.append(cell);
+                }
+            }
+        m_maxClassSize = qMax(m_maxClassSize, cls.atoms.count());
+        m_classes.append(cls);
+    }
+    if (m_maxClassSize > MaxClassSize)
+    {
+        m_stateCount = 0;
+        return;
+    }
+
+    // Pascal's triangle up to the largest free cell count
+    int maxFree = 0;
+    foreach (const AtomClass& cls, m_classes)
+        maxFree = qMax(maxFree, cls.freeCells.count());
+    const int row = m_maxClassSize + 1;
+    m_binomials.fill(0, (maxFree + 1) * row);
+    for (int n = 0; n <= maxFree; ++n)
+    {
+        m_binomials[n*row] = 1;
+        for (int k = 1; k <= qMin(n, m_maxClassSize); ++k)
+        {
+            const quint64 a = m_binomials.at((n - 1)*row + k - 1);
+            const quint64 b = m_binomials.at((n - 1)*row + k);
+            m_binomials[n*row + k] = a + b < a ? ~Q_UINT64_C(0) : a + b;
+        }
+    }
+
+    for (int c = 0; c < m_classes.count(); ++c)
+    {
+        AtomClass& cls = m_classes[c];
+        cls.subsetCount = binomial(cls.freeCells.count(), cls.atoms.count());
+        if (cls.subsetCount == 0 || cls.subsetCount == ~Q_UINT64_C(0)
+            || (m_stateCount && m_stateCount > ~Q_UINT64_C(0) / cls.subsetCount))
+            m_stateCount = 0;
+        else if (m_stateCount)
+            m_stateCount *= cls.subsetCount;
+    }
+}
@@ -0,0 +1,126 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_STATERANKING_H
+#define KATOMIC_STATERANKING_H
+
+#include <QVector>
+
+#include "levelset.h"
+
+/**
+ * Perfect numbering of a level's positions, for searches that keep one bit
+ * or byte per position in a flat array instead of a hash table.
+ *
+ * Atoms of a kind are interchangeable (see AtomClasses), so the atoms of
+ * each kind take some k of the n cells not dead for that kind (see
+ * LevelData::isDeadCell()), and that k-subset is numbered by its
+ * colexicographic rank among all C(n, k) of them. A position's rank mixes
+ * the ranks of all kinds. Positions with two atoms in one cell get numbers
+ * too, which wastes little as long as atoms are few compared to cells.
+ */
+class StateRanking
+{
+public:
+    explicit StateRanking(const LevelData* level);
+
+    /**
+     *  Number of ranks, 0 if there are more than fit into 64 bits
+     */
+    quint64 stateCount() const { return m_stateCount; }
+
+    /**
+     *  Rank of the position with atom i in cells[i], in any order of
+     *  identical atoms
+     */
+    template<typename Cell>
+    quint64 rank(const Cell* cells) const
+    {
+        quint64 rank = 0;
+        int sorted[MaxClassSize];
+        for (int c = 0; c < m_classes.count(); ++c)
+        {
+            const AtomClass& cls = m_classes.at(c);
+            const int k = cls.atoms.count();
+            // free cell indices of the class, ascending
+            for (int i = 0; i < k; ++i)
+            {
+                const int index = cls.freeIndex.at(cells[cls.atoms.at(i)]);
+                int j = i;
+                for (; j > 0 && sorted[j - 1] > index; --j)
+                    sorted[j] = sorted[j - 1];
+                sorted[j] = index;
+            }
+            quint64 classRank = 0;
+            for (int i = 0; i < k; ++i)
+                classRank += binomial(sorted[i], i + 1);
+            rank = rank * cls.subsetCount + classRank;
+        }
+        return rank;
+    }
+
+    /**
+     *  Position of rank, with the cells of identical atoms in ascending order
+     */
+    template<typename Cell>
+    void unrank(quint64 rank, Cell* cells) const
+    {
+        for (int c = m_classes.count() - 1; c >= 0; --c)
+        {
+            const AtomClass& cls = m_classes.at(c);
+            quint64 classRank = rank % cls.subsetCount;
+            rank /= cls.subsetCount;
+            int index = cls.freeCells.count();
+            for (int i = cls.atoms.count() - 1; i >= 0; --i)
+            {
+                do
+                    index--;
+                while (binomial(index, i + 1) > classRank);
+                classRank -= binomial(index, i + 1);
+                cells[cls.atoms.at(i)] = cls.freeCells.at(index);
+            }
+        }
+    }
+
+private:
+    // atoms of one kind in a level, more than that aren't ranked
+    enum { MaxClassSize = 64 };
+
+    struct AtomClass
+    {
+        // indices within LevelData::atomElements(), ascending
+        QVector<int> atoms;
+        // cells not dead for the kind, and the position of each cell among
+        // them, -1 for the others
+        QVector<int> freeCells;
+        QVector<int> freeIndex;
+        quint64 subsetCount;
+    };
+
+    quint64 binomial(int n, int k) const { return n < k ? 0 : m_binomials.at(n*(m_maxClassSize + 1) + k); }
+
+    QVector<AtomClass> m_classes;
+    int m_maxClassSize;
+    // C(n, k) at n*(m_maxClassSize + 1) + k, saturated at ~0
+    QVector<quint64> m_binomials;
+    quint64 m_stateCount;
+};
+
+#endif
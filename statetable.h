@@ -0,0 +1,148 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_STATETABLE_H
+#define KATOMIC_STATETABLE_H
+
+#include <QtGlobal>
+
+#include <string.h>
+#include <vector>
+
+/**
+ * Visited set of a search, storing each position once together with the
+ * move that first reached it.
+ *
+ * A position is packed as its atom cells, one Cell per atom, and all of them
+ * live in one array in insertion order. The hash index only holds 32-bit
+ * state numbers, so a state costs atomCount*sizeof(Cell) + 6 bytes plus
+ * index slots, and breadth-first search can use the insertion order itself
+ * as its queue.
+ *
+ * Plain std::vector is used as the arrays can grow past what QVector can hold.
+ */
+template<typename Cell>
+class StateTable
+{
+public:
+    enum { NoParent = 0xffffffff };
+
+    explicit StateTable(int atomCount)
+        : m_atomCount(atomCount), m_count(0), m_slots(1024, 0)
+    {
+    }
+
+    quint32 count() const { return m_count; }
+    const Cell* state(quint32 idx) const { return &m_cells[size_t(idx) * m_atomCount]; }
+    /**
+     *  State the move returned by move() was made from, NoParent for the start
+     */
+    quint32 parent(quint32 idx) const { return m_parents[idx]; }
+    /**
+     *  Move that first reached state idx, as set on insert()
+     */
+    quint16 move(quint32 idx) const { return m_moves[idx]; }
+
+    /**
+     *  Adds the position cells unless it is already known.
+     *  @return number of the added state, or NoParent if it was known
+     */
+    quint32 insert(const Cell* cells, quint32 parent, quint16 move)
+    {
+        if ((m_count + 1) * 4 > m_slots.size() * 3)
+            grow();
+
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slot = hashOf(cells) & mask; ; slot = (slot + 1) & mask)
+        {
+            const quint32 entry = m_slots[slot];
+            if (entry == 0)
+            {
+                m_slots[slot] = m_count + 1;
+                break;
+            }
+            if (memcmp(state(entry - 1), cells, m_atomCount * sizeof(Cell)) == 0)
+                return NoParent;
+        }
+
+        m_cells.insert(m_cells.end(), cells, cells + m_atomCount);
+        m_parents.push_back(parent);
+        m_moves.push_back(move);
+        return m_count++;
+    }
+
+    /**
+     *  Number of the state with cells, NoParent if it isn't known
+     */
+    quint32 find(const Cell* cells) const
+    {
+        const size_t mask = m_slots.size() - 1;
+        for (size_t slot = hashOf(cells) & mask; ; slot = (slot + 1) & mask)
+        {
+            const quint32 entry = m_slots[slot];
+            if (entry == 0)
+                return NoParent;
+            if (memcmp(state(entry - 1), cells, m_atomCount * sizeof(Cell)) == 0)
+                return entry - 1;
+        }
+    }
+
+    /**
+     *  Bytes held by the table, including spare capacity
+     */
+    quint64 memoryUsage() const
+    {
+        return quint64(m_cells.capacity()) * sizeof(Cell) + quint64(m_parents.capacity()) * sizeof(quint32)
+            + quint64(m_moves.capacity()) * sizeof(quint16) + quint64(m_slots.size()) * sizeof(quint32);
+    }
+
+private:
+    quint64 hashOf(const Cell* cells) const
+    {
+        quint64 h = Q_UINT64_C(0xcbf29ce484222325);
+        for (int i = 0; i < m_atomCount; ++i)
+            h = (h ^ cells[i]) * Q_UINT64_C(0x100000001b3);
+        return h ^ (h >> 29);
+    }
+
+    void grow()
+    {
+        std::vector<quint32> slots(m_slots.size() * 2, 0);
+        const size_t mask = slots.size() - 1;
+        for (quint32 idx = 0; idx < m_count; ++idx)
+        {
+            size_t slot = hashOf(state(idx)) & mask;
+            while (slots[slot] != 0)
+                slot = (slot + 1) & mask;
+            slots[slot] = idx + 1;
+        }
+        m_slots.swap(slots);
+    }
+
+    int m_atomCount;
+    quint32 m_count;
+    std::vector<Cell> m_cells;
+    std::vector<quint32> m_parents;
+    std::vector<quint16> m_moves;
+    // open addressing, state number + 1 per slot, 0 for empty slots
+    std::vector<quint32> m_slots;
+};
+
+#endif
@@ -0,0 +1,250 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+
+#include "tablebase.h"
+
+#include <QCryptographicHash>
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <string.h>
+#include <vector>
+
+// file layout: magic, format version, level key, table size, then the table
+static const char TablebaseMagic[8] = { 'K', 'A', 'T', 'O', 'M', 'T', 'B', 'S' };
+static const quint32 TablebaseVersion = 1;
+static const int TablebaseKeySize = 40;
+static const int TablebaseHeaderSize = 8 + 4 + TablebaseKeySize + 8;
+
+Tablebase::Tablebase(const LevelData* level)
+    : m_level(level), m_ranking(level), m_data(0)
+{
+}
+
+QByteArray Tablebase::cacheKey(const LevelData* level)
+{
+    // everything the table depends on: walls, molecule and the atoms. start
+    // cells count too, as they decide which cells StateRanking numbers
+    QByteArray key;
+    QDataStream stream(&key, QIODevice::WriteOnly);
+    stream << TablebaseVersion << level->width() << level->height();
+    for (int y = 0; y < level->height(); ++y)
+        for (int x = 0; x < level->width(); ++x)
+            stream << level->containsWallAt(x, y);
+    foreach (const LevelData::Element& el, level->moleculeAtoms())
+        stream << el.atom << el.x << el.y;
+    foreach (const LevelData::Element& el, level->atomElements())
+        stream << el.atom << el.x << el.y;
+    return QCryptographicHash::hash(key, QCryptographicHash::Sha1).toHex();
+}
+
+Tablebase* Tablebase::open(const LevelData* level, const QString& fileName)
+{
+    Tablebase* tablebase = new Tablebase(level);
+    QFile& file = tablebase->m_file;
+    file.setFileName(fileName);
+    if (tablebase->m_ranking.stateCount() == 0 || !file.open(QIODevice::ReadOnly))
+    {
+        delete tablebase;
+        return 0;
+    }
+
+    const QByteArray header = file.read(TablebaseHeaderSize);
+    QDataStream stream(header.mid(8));
+    quint32 version;
+    QByteArray key(TablebaseKeySize, '\0');
+    quint64 size;
+    stream >> version;
+    stream.readRawData(key.data(), TablebaseKeySize);
+    stream >> size;
+    const quint64 count = tablebase->m_ranking.stateCount();
+    if (header.size() != TablebaseHeaderSize || memcmp(header.constData(), TablebaseMagic, 8) != 0
+        || version != TablebaseVersion || key != cacheKey(level)
+        || size != count || quint64(file.size()) != TablebaseHeaderSize + count)
+    {
+        qDebug() << "ignoring tablebase of another level" << fileName;
+        delete tablebase;
+        return 0;
+    }
+
+    tablebase->m_data = file.map(TablebaseHeaderSize, count);
+    if (!tablebase->m_data)
+    {
+        delete tablebase;
+        return 0;
+    }
+    return tablebase;
+}
+
+qint64 Tablebase::build(const LevelData* level, const QString& fileName, quint64 maxStates)
+{
+    const StateRanking ranking(level);
+    const quint64 count = ranking.stateCount();
+    BoardState* board = BoardState::create(level);
+    const int atomCount = board->atomCount();
+    if (count == 0 || count > maxStates || atomCount != level->atomElements().count())
+    {
+        delete board;
+        return -1;
+    }
+
+    std::vector<uchar> table(count, uchar(Unknown));
+    QVector<int> cells(atomCount);
+    qint64 known = 0;
+
+    // goal positions: every anchor, identical atoms in any one order as
+    // the ranking doesn't tell them apart
+    QVector<int> atomNums(atomCount);
+    for (int atom = 0; atom < atomCount; ++atom)
+        atomNums[atom] = board->atomNum(atom);
+    for (int anchor = 0; anchor < level->goalAnchorCount() && atomCount == level->moleculeAtomCount(); ++anchor)
+    {
+        bool placed = level->goalCells(anchor, atomNums, &cells);
+        for (int atom = 0; atom < atomCount && placed; ++atom)
+            placed = !level->isDeadCell(atomNums.at(atom), cells.at(atom));
+        if (!placed)
+            continue;
+        const quint64 idx = ranking.rank(cells.constData());
+        if (table[idx] != 0)
+        {
+            table[idx] = 0;
+            known++;
+        }
+    }
+
+    // one sweep over the table per depth. positions outside the ranking
+    // (atoms in dead cells) can't be reached from the start, so they are
+    // left out
+    MoveList moves;
+    bool complete = false;
+    for (int depth = 0; depth + 1 < Unknown && !complete; ++depth)
+    {
+        qint64 added = 0;
+        for (quint64 idx = 0; idx < count; ++idx)
+        {
+            if (table[idx] != depth)
+                continue;
+            ranking.unrank(idx, cells.data());
+            board->setAtomCells(cells.constData());
+            board->generateReverseMoves(&moves);
+            for (int m = 0; m < moves.count; ++m)
+            {
+                const int atom = moves.atoms[m];
+                const KAtomic::Direction dir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+                const KAtomic::Direction back = BoardState::opposite(dir);
+                for (int numCells = 1; numCells <= moves.distances[m]; ++numCells)
+                {
+                    board->moveAtom(atom, back, numCells);
+                    cells[atom] = board->atomCell(atom);
+                    if (!level->isDeadCell(board->atomNum(atom), cells[atom]))
+                    {
+                        const quint64 from = ranking.rank(cells.constData());
+                        if (table[from] == Unknown)
+                        {
+                            table[from] = depth + 1;
+                            added++;
+                        }
+                    }
+                    board->moveAtom(atom, dir, numCells);
+                    cells[atom] = board->atomCell(atom);
+                }
+            }
+        }
+        complete = added == 0;
+        known += added;
+    }
+    delete board;
+    // positions left Unknown would look unsolvable although they aren't.
+    // the sweep of the last depth isn't run, so a table whose farthest
+    // positions are exactly Unknown - 1 moves away is refused too
+    if (!complete)
+        return -1;
+
+    QDir().mkpath(QFileInfo(fileName).absolutePath());
+    QSaveFile file(fileName);
+    if (!file.open(QIODevice::WriteOnly))
+        return -1;
+    QByteArray header(TablebaseMagic, 8);
+    QDataStream stream(&header, QIODevice::Append);
+    const QByteArray key = cacheKey(level);
+    stream << TablebaseVersion;
+    stream.writeRawData(key.constData(), key.size());
+    stream << count;
+    file.write(header);
+    // in pieces, QIODevice writes are limited to what an int can count
+    for (quint64 offset = 0; offset < count; offset += 1 << 24)
+        file.write(reinterpret_cast<const char*>(&table[offset]), qMin(count - offset, quint64(1) << 24));
+    if (!file.commit())
+    {
+        qDebug() << "failed to save tablebase" << fileName;
+        return -1;
+    }
+    return known;
+}
+
+int Tablebase::distance(const BoardState* board) const
+{
+    m_cells.resize(board->atomCount());
+    for (int i = 0; i < board->atomCount(); ++i)
+    {
+        m_cells[i] = board->atomCell(i);
+        if (m_level->isDeadCell(board->atomNum(i), m_cells[i]))
+            return -1;
+    }
+    return cellsDistance();
+}
+
+int Tablebase::cellsDistance() const
+{
+    const int dist = m_data[m_ranking.rank(m_cells.constData())];
+    return dist == Unknown ? -1 : dist;
+}
+
+bool Tablebase::bestMove(const BoardState* board, int* atom, KAtomic::Direction* dir) const
+{
+    const int dist = distance(board);
+    if (dist <= 0)
+        return false;
+
+    // a move changes one cell, so the positions after each move are looked
+    // up by changing that cell of m_cells, without moving atoms on a board
+    MoveList moves;
+    board->generateMoves(&moves);
+    for (int m = 0; m < moves.count; ++m)
+    {
+        const int moved = moves.atoms[m];
+        const KAtomic::Direction moveDir = static_cast<KAtomic::Direction>(moves.dirs[m]);
+        const int from = m_cells.at(moved);
+        m_cells[moved] = from + moves.distances[m] * m_level->step(moveDir);
+        const bool closer = !m_level->isDeadCell(board->atomNum(moved), m_cells.at(moved)) && cellsDistance() == dist - 1;
+        m_cells[moved] = from;
+        if (closer)
+        {
+            *atom = moved;
+            *dir = moveDir;
+            return true;
+        }
+    }
+    return false;
+}
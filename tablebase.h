@@ -0,0 +1,94 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_TABLEBASE_H
+#define KATOMIC_TABLEBASE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+#include <QVector>
+
+#include "boardstate.h"
+#include "stateranking.h"
+
+/**
+ * Exact number of moves left to the molecule from every position of a
+ * small level, so the game can give optimal hints without searching.
+ *
+ * Tables are built ahead of time by katomic-solve with a retrograde
+ * analysis: a breadth-first search backwards from all goal positions,
+ * where a backward move takes an atom that stands stopped in some
+ * direction back along the free run behind it. Positions are numbered by
+ * StateRanking and the table holds one byte per number, saved into a file
+ * in the user's data directory (see LevelSet::tablebaseFileName()) that is
+ * memory-mapped when the player first asks for a hint on the level.
+ */
+class Tablebase
+{
+public:
+    enum { Unknown = 0xff };
+
+    /**
+     *  Maps the table of level saved as fileName, 0 if there is none or it
+     *  belongs to another level
+     */
+    static Tablebase* open(const LevelData* level, const QString& fileName);
+
+    /**
+     *  Builds the table of level and saves it as fileName
+     *  @param maxStates largest table to build, in bytes
+     *  @return number of positions the molecule can be made from, or -1 if
+     *  the table is too large, some position is further from the molecule
+     *  than a byte can count or the table can't be saved
+     */
+    static qint64 build(const LevelData* level, const QString& fileName, quint64 maxStates);
+
+    /**
+     *  Moves left to the molecule from the position of board, -1 if it
+     *  can't be made from there
+     */
+    int distance(const BoardState* board) const;
+
+    /**
+     *  First move of a shortest solution from the position of board
+     *  @return false if board is solved or can't be solved
+     */
+    bool bestMove(const BoardState* board, int* atom, KAtomic::Direction* dir) const;
+
+private:
+    explicit Tablebase(const LevelData* level);
+
+    static QByteArray cacheKey(const LevelData* level);
+    /**
+     *  Table entry of the position in m_cells, -1 if the molecule can't be
+     *  made from there
+     */
+    int cellsDistance() const;
+
+    const LevelData* m_level;
+    StateRanking m_ranking;
+    QFile m_file;
+    const uchar* m_data;
+    // position looked up last, kept so that lookups don't allocate
+    mutable QVector<int> m_cells;
+};
+
+#endif
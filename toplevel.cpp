@@ -97,6 +97,7 @@ void AtomTopLevel::createMenu()
     // Move
     m_undoAct = KStandardGameAction::undo(m_gameWid->playfield(), SLOT(undo()), actionCollection());
     m_redoAct = KStandardGameAction::redo(m_gameWid->playfield(), SLOT(redo()), actionCollection());
+    KStandardGameAction::hint(m_gameWid->playfield(), SLOT(showHint()), actionCollection());
 
 
     m_prevLevelAct = actionCollection()->addAction( QStringLiteral(  "prev_level" ) );
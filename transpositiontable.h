@@ -0,0 +1,152 @@
+/*******************************************************************
+ *
+ * This file is part of the KDE project "KAtomic"
+ *
+ * KAtomic is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation; either version 2, or (at your option)
+ * any later version.
+ *
+ * KAtomic is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with KAtomic; see the file COPYING.  If not, write to
+ * the Free Software Foundation, 51 Franklin Street, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ *
+ ********************************************************************/
+#ifndef KATOMIC_TRANSPOSITIONTABLE_H
+#define KATOMIC_TRANSPOSITIONTABLE_H
+
+#include <QtGlobal>
+
+#include <atomic>
+#include <new>
+
+/**
+ * Positions an iterative deepening search has been to, by position hash
+ * (BoardState::hash()), with the fewest moves they were reached in.
+ *
+ * Reaching a position again in the same iteration with at least as many
+ * moves can't lead anywhere the first visit doesn't, so IDA* skips it.
+ *
+ * The table has a fixed size, set when it is created. Entries are grouped
+ * in buckets of one cache line, and a position can only be in the bucket its
+ * hash picks. Two entries of a bucket are depth-preferred: they keep the
+ * positions with the most moves left to the bound, whose subtrees are the
+ * most expensive to search again. A position that ousts one of them moves
+ * it to one of the other two, which always take the newest position. A full
+ * table loses positions and with them only skipped work.
+ *
+ * Threads may share a table. An entry stores its data and the hash xor the
+ * data, each in one atomic word, so an entry written by two threads at once
+ * just doesn't match either hash.
+ */
+class TranspositionTable
+{
+public:
+    /**
+     *  Creates a table of at most maxBytes, but at least one bucket
+     */
+    explicit TranspositionTable(quint64 maxBytes)
+    {
+        m_size = 1;
+        while (m_size * 2 * sizeof(Bucket) <= maxBytes)
+            m_size *= 2;
+        m_buckets = static_cast<Bucket*>(qMallocAligned(m_size * sizeof(Bucket), sizeof(Bucket)));
+        for (quint64 i = 0; i < m_size; ++i)
+            new (&m_buckets[i]) Bucket();
+    }
+    ~TranspositionTable()
+    {
+        qFreeAligned(m_buckets);
+    }
+
+    /**
+     *  Tells if the position with hash was reached in at most g moves in the
+     *  iteration with bound already, and records this visit if it wasn't
+     */
+    bool visit(quint64 hash, int bound, int g)
+    {
+        Entry* entries = m_buckets[hash & (m_size - 1)].entries;
+        const quint64 data = quint64(bound) << 16 | g;
+
+        for (int i = 0; i < EntriesPerBucket; ++i)
+        {
+            const quint64 old = entries[i].data.load(std::memory_order_relaxed);
+            if ((entries[i].check.load(std::memory_order_relaxed) ^ old) != hash)
+                continue;
+            if (int(old >> 16) == bound && int(old & 0xffff) <= g)
+                return true;
+            entries[i].store(hash, data);
+            return false;
+        }
+
+        Entry& replaced = entries[DepthPreferred + (hash >> 63)];
+        int weakest = 0;
+        for (int i = 1; i < DepthPreferred; ++i)
+        {
+            if (movesLeft(entries[i], bound) < movesLeft(entries[weakest], bound))
+                weakest = i;
+        }
+        if (bound - g > movesLeft(entries[weakest], bound))
+        {
+            replaced.copy(entries[weakest]);
+            entries[weakest].store(hash, data);
+        }
+        else
+            replaced.store(hash, data);
+        return false;
+    }
+
+private:
+    enum { EntriesPerBucket = 4, DepthPreferred = 2 };
+
+    struct Entry
+    {
+        std::atomic<quint64> check;
+        std::atomic<quint64> data;
+
+        void store(quint64 hash, quint64 newData)
+        {
+            check.store(hash ^ newData, std::memory_order_relaxed);
+            data.store(newData, std::memory_order_relaxed);
+        }
+        void copy(const Entry& other)
+        {
+            check.store(other.check.load(std::memory_order_relaxed), std::memory_order_relaxed);
+            data.store(other.data.load(std::memory_order_relaxed), std::memory_order_relaxed);
+        }
+    };
+
+    struct Bucket
+    {
+        Entry entries[EntriesPerBucket];
+
+        Bucket()
+        {
+            for (int i = 0; i < EntriesPerBucket; ++i)
+                entries[i].store(0, 0);
+        }
+    };
+
+    /**
+     *  Moves from where entry was reached to bound, -1 for empty entries
+     *  and those of other iterations
+     */
+    static int movesLeft(const Entry& entry, int bound)
+    {
+        const quint64 data = entry.data.load(std::memory_order_relaxed);
+        if (data == 0 || int(data >> 16) != bound)
+            return -1;
+        return bound - int(data & 0xffff);
+    }
+
+    Bucket* m_buckets;
+    quint64 m_size;
+};
+
+#endif